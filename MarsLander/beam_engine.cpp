@@ -0,0 +1,325 @@
+#include "beam_engine.h"
+#include "counters.h"
+#include "parallel.h"
+#include "trace.h"
+
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <queue>
+
+namespace
+  {
+  const int angle_deltas[5] = { -maximum_angle_rotation, -5, 0, 5, maximum_angle_rotation };
+
+  // meters of distance that one m/s of speed above what can still be braked costs
+  const float speed_weight = 200.f;
+  // meters of distance that one degree of tilt costs close above the landing zone
+  const float tilt_weight = 4.f;
+  // meters of distance that one meter of climbing costs
+  const float climb_factor = 4.f;
+  // meters before the landing zone over which the allowed touch down speed fades out
+  const float approach = 1000.f;
+  // seconds of drift after which the distance is read
+  const float lookahead = 5.f;
+  // Braking that is assumed to be available, in m/s^2. Full thrust at 30 degrees brakes 2 m/s^2 horizontally and
+  // upright full thrust only 0.289 m/s^2 vertically, but the lander rarely brakes in one direction only.
+  const float horizontal_braking = 0.3f;
+  const float vertical_braking = 0.05f;
+
+  enum outcome
+    {
+    flying,
+    crashed,
+    touched_down // in the landing zone, maybe a valid landing
+    };
+
+  // Upward ray parity: a point is in the rock if the surface crosses the vertical above it an odd number of times.
+  void build_distance_field(beam_search& b)
+    {
+    b.columns = (W + b.cell_size - 1) / b.cell_size;
+    b.rows = (H + b.cell_size - 1) / b.cell_size;
+    std::vector<char> rock((size_t)b.columns * b.rows, 0);
+    b.ground.assign((size_t)b.columns * b.rows, 0.f);
+    std::vector<float> crossings;
+    for (int c = 0; c < b.columns; ++c)
+      {
+      const float x = (c + 0.5f) * b.cell_size;
+      crossings.clear();
+      for (size_t i = 1; i < surface_points.size(); ++i)
+        {
+        const vec2<int>& p = surface_points[i - 1];
+        const vec2<int>& q = surface_points[i];
+        // half open, so that a vertex is counted once
+        if (x < std::min(p.x, q.x) || x >= std::max(p.x, q.x))
+          continue;
+        crossings.push_back(p.y + (x - p.x) / (float)(q.x - p.x) * (q.y - p.y));
+        }
+      for (int r = 0; r < b.rows; ++r)
+        {
+        const float y = (r + 0.5f) * b.cell_size;
+        int above = 0;
+        float ground = 0.f;
+        for (float cy : crossings)
+          {
+          above += cy > y ? 1 : 0;
+          if (cy <= y)
+            ground = std::max(ground, cy);
+          }
+        rock[(size_t)r * b.columns + c] = (char)(above & 1);
+        b.ground[(size_t)r * b.columns + c] = ground;
+        }
+      }
+
+    // Dijkstra from the cells right above the landing zone. Rock cells get a distance
+    // from their free neighbours, for landers in a cell whose center is in the rock,
+    // but the search does not continue through them.
+    b.distance.assign((size_t)b.columns * b.rows, -1.f);
+    typedef std::pair<float, int> entry;
+    std::priority_queue<entry, std::vector<entry>, std::greater<entry>> queue;
+    const int zone_row = std::min(b.rows - 1, (int)((landing_zone_y + 0.5f * b.cell_size) / b.cell_size));
+    for (int c = 0; c < b.columns; ++c)
+      {
+      const float x = (c + 0.5f) * b.cell_size;
+      if (x < landing_zone_x0 || x > landing_zone_x1)
+        continue;
+      const float d = (zone_row + 0.5f) * b.cell_size - landing_zone_y;
+      const int cell = zone_row * b.columns + c;
+      b.distance[cell] = d;
+      queue.push(entry(d, cell));
+      }
+    // climbing is slow, upright full thrust barely beats gravity, so height that has to be regained costs extra
+    const float diagonal = b.cell_size * std::sqrt(2.f);
+    const float climb = b.cell_size * climb_factor;
+    const float climb_diagonal = b.cell_size * std::sqrt(1.f + climb_factor * climb_factor);
+    while (!queue.empty())
+      {
+      const entry e = queue.top();
+      queue.pop();
+      if (e.first > b.distance[e.second] || rock[e.second])
+        continue;
+      const int r = e.second / b.columns;
+      const int c = e.second % b.columns;
+      for (int dr = -1; dr <= 1; ++dr)
+        {
+        for (int dc = -1; dc <= 1; ++dc)
+          {
+          const int nr = r + dr, nc = c + dc;
+          if ((dr == 0 && dc == 0) || nr < 0 || nr >= b.rows || nc < 0 || nc >= b.columns)
+            continue;
+          const int neighbour = nr * b.columns + nc;
+          // the lander flies from the neighbour to this cell, so dr < 0 is a climb
+          const float step = dr < 0 ? (dc != 0 ? climb_diagonal : climb) : (dr != 0 && dc != 0 ? diagonal : (float)b.cell_size);
+          const float d = e.first + step;
+          if (b.distance[neighbour] < 0.f || d < b.distance[neighbour])
+            {
+            b.distance[neighbour] = d;
+            queue.push(entry(d, neighbour));
+            }
+          }
+        }
+      }
+    }
+
+  // Nodes whose quantized states are equal share a key, only the cheapest of them is expanded.
+  uint64_t state_key(const simulation_data& sd)
+    {
+    const uint64_t x = (uint64_t)std::max(0, std::min(511, (int)(sd.p.x / 20.f)));
+    const uint64_t y = (uint64_t)std::max(0, std::min(255, (int)(sd.p.y / 20.f)));
+    const uint64_t hs = (uint64_t)std::max(0, std::min(1023, (int)std::floor(sd.v.x / 2.f) + 512));
+    const uint64_t vs = (uint64_t)std::max(0, std::min(1023, (int)std::floor(sd.v.y / 2.f) + 512));
+    const uint64_t r = (uint64_t)(sd.R + maximum_angle);
+    const uint64_t p = (uint64_t)sd.P;
+    return x | (y << 9) | (hs << 17) | (vs << 27) | (r << 37) | (p << 45);
+    }
+
+  // The chromosome that flies to node index of step, followed by zero genes.
+  void node_chromosome(chromosome& c, const beam_search& b, int step, int index)
+    {
+    c.resize(chromosome_size);
+    std::fill(c.begin() + step, c.end(), gene{ 0, 0 });
+    for (int d = step; d > 0; --d)
+      {
+      const beam_node& n = b.steps[d][index];
+      c[d - 1] = n.g;
+      index = n.parent;
+      }
+    }
+
+  // c becomes the corrected chromosome if it is one
+  bool is_a_solution(chromosome& c)
+    {
+    evaluate(nullptr, c);
+    simulation_data sd, prev_sd;
+    run_chromosome(sd, prev_sd, c);
+    return is_a_valid_landing(sd, prev_sd);
+    }
+
+  void restart(beam_search& b)
+    {
+    b.steps.resize(1);
+    b.steps[0].resize(1);
+    beam_node& root = b.steps[0][0];
+    root.sd = simdata;
+    root.parent = -1;
+    root.g.angle = 0;
+    root.g.thrust = 0;
+    root.cost = beam_cost(b, simdata);
+    }
+  }
+
+float beam_cost(const beam_search& b, const simulation_data& sd)
+  {
+  const int c = std::max(0, std::min(b.columns - 1, (int)(sd.p.x / b.cell_size)));
+  const int r = std::max(0, std::min(b.rows - 1, (int)(sd.p.y / b.cell_size)));
+  const size_t cell = (size_t)r * b.columns + c;
+  if (b.distance[cell] < 0.f)
+    return std::numeric_limits<float>::max();
+  // the distance where the lander drifts to, so that momentum away from the zone is paid now
+  const int ca = std::max(0, std::min(b.columns - 1, (int)((sd.p.x + lookahead * sd.v.x) / b.cell_size)));
+  const int ra = std::max(0, std::min(b.rows - 1, (int)((sd.p.y + lookahead * sd.v.y) / b.cell_size)));
+  const float ahead = b.distance[(size_t)ra * b.columns + ca];
+  const float d = ahead < 0.f ? b.distance[cell] : ahead;
+  const float hd = sd.p.x < landing_zone_x0 ? landing_zone_x0 - sd.p.x : sd.p.x > landing_zone_x1 ? sd.p.x - landing_zone_x1 : 0.f;
+  const float dy = std::max(0.f, sd.p.y - landing_zone_y);
+  // the descent is braked before the ground below or the height of the landing zone, the horizontal speed before the landing zone
+  const float clearance = std::min(dy, std::max(0.f, sd.p.y - b.ground[cell]));
+  const float allowed_hs = 0.8f * maximum_horizontal_speed + std::sqrt(2.f * horizontal_braking * hd);
+  // touching down is allowed only over the landing zone, elsewhere the descent has to stop in time
+  const float allowed_vs = 0.8f * maximum_vertical_speed * std::max(0.f, 1.f - hd / approach) + std::sqrt(2.f * vertical_braking * clearance);
+  const float excess = std::max(0.f, std::abs(sd.v.x) - allowed_hs) + std::max(0.f, -sd.v.y - allowed_vs) + std::max(0.f, sd.v.y - maximum_vertical_speed);
+  float cost = d + speed_weight * excess;
+  if (hd == 0.f && dy < 500.f)
+    cost += tilt_weight * std::abs(sd.R) * (500.f - dy) / 500.f;
+  return cost;
+  }
+
+void init_beam(beam_search& b)
+  {
+  build_distance_field(b);
+  b.current_width = std::max(1, b.width);
+  b.restarts = 0;
+  b.solutions.clear();
+  restart(b);
+  }
+
+void expand_beam(beam_search& b)
+  {
+  trace_scope trace("expand_beam");
+  const int step = (int)b.steps.size() - 1;
+  const std::vector<beam_node>& parents = b.steps[step];
+  COUNT_HOT_PATH_IF(allocations, b.children.capacity() < parents.size() * beam_moves);
+  b.children.resize(parents.size() * beam_moves);
+  b.outcomes.resize(b.children.size());
+  std::vector<char>& outcomes = b.outcomes;
+  b.landings.clear();
+  std::mutex landings_mutex;
+#if defined(MARSLANDER_COUNTERS)
+  hot_path_counters sum = hot_path_counters();
+  std::mutex sum_mutex;
+#endif
+  parallel_for((int)parents.size(), number_of_threads, [&](int first, int last)
+    {
+#if defined(MARSLANDER_COUNTERS)
+    hot_path_chunk chunk(sum, sum_mutex);
+#endif
+    chromosome c;
+    for (int i = first; i < last; ++i)
+      {
+      const beam_node& parent = parents[i];
+      const int PX = (int)std::round(parent.sd.p.x);
+      const int PY = (int)std::round(parent.sd.p.y);
+      for (int m = 0; m < beam_moves; ++m)
+        {
+        beam_node& child = b.children[(size_t)i * beam_moves + m];
+        child.parent = i;
+        child.g.angle = angle_deltas[m / 3];
+        child.g.thrust = m % 3 - 1;
+        child.sd = parent.sd;
+        // the same clamping as in evaluate, so that the chromosome of the node replays it exactly
+        simulate(child.sd, std::max(-maximum_angle, std::min(maximum_angle, parent.sd.R + child.g.angle)), std::max(0, std::min(maximum_thrust, parent.sd.P + child.g.thrust)));
+        const int X = (int)std::round(child.sd.p.x);
+        const int Y = (int)std::round(child.sd.p.y);
+        char& o = outcomes[(size_t)i * beam_moves + m];
+        if (X < 0 || X >= W || Y < 0 || Y >= H)
+          o = crashed;
+        else if (crashed_or_landed(X, Y, PX, PY))
+          o = X >= landing_zone_x0 && X <= landing_zone_x1 && PY > landing_zone_y ? touched_down : crashed;
+        else
+          o = flying;
+        child.cost = o == flying ? beam_cost(b, child.sd) : std::numeric_limits<float>::max();
+        // most touch downs are too fast or tilted, only the others are worth replaying
+        if (o != touched_down || !is_a_valid_landing(child.sd, parent.sd))
+          continue;
+        node_chromosome(c, b, step, i);
+        c[step] = child.g;
+        if (is_a_solution(c))
+          {
+          std::lock_guard<std::mutex> lock(landings_mutex);
+          b.landings.emplace_back((int)((size_t)i * beam_moves + m), c);
+          }
+        }
+      }
+    });
+#if defined(MARSLANDER_COUNTERS)
+  add(thread_counters, sum);
+#endif
+
+  // in the order of the children, so that the search does not depend on the threads
+  std::sort(b.landings.begin(), b.landings.end(), [](const auto& left, const auto& right) { return left.first < right.first; });
+  for (auto& landing : b.landings)
+    b.solutions.push_back(std::move(landing.second));
+  b.keys.clear();
+  for (size_t i = 0; i < b.children.size(); ++i)
+    {
+    if (outcomes[i] == flying && b.children[i].cost < std::numeric_limits<float>::max())
+      b.keys.emplace_back(state_key(b.children[i].sd), (int)i);
+    }
+  const std::vector<beam_node>& children = b.children;
+  std::sort(b.keys.begin(), b.keys.end(), [&](const auto& left, const auto& right)
+    {
+    if (left.first != right.first)
+      return left.first < right.first;
+    if (children[left.second].cost != children[right.second].cost)
+      return children[left.second].cost < children[right.second].cost;
+    return left.second < right.second;
+    });
+  b.keys.erase(std::unique(b.keys.begin(), b.keys.end(), [](const auto& left, const auto& right) { return left.first == right.first; }), b.keys.end());
+  const size_t width = std::min(b.keys.size(), (size_t)b.current_width);
+  const auto cheaper = [&](const auto& left, const auto& right)
+    {
+    if (children[left.second].cost != children[right.second].cost)
+      return children[left.second].cost < children[right.second].cost;
+    return left.second < right.second;
+    };
+  std::partial_sort(b.keys.begin(), b.keys.begin() + width, b.keys.end(), cheaper);
+
+  if (width == 0 || step + 1 == chromosome_size)
+    {
+    b.current_width = std::max(b.current_width, std::min(b.maximum_width, 2 * b.current_width));
+    ++b.restarts;
+    restart(b);
+    return;
+    }
+  b.steps.emplace_back();
+  std::vector<beam_node>& next = b.steps.back();
+  next.reserve(width);
+  for (size_t i = 0; i < width; ++i)
+    next.push_back(b.children[b.keys[i].second]);
+  }
+
+void beam_population(population& p, const beam_search& b, int size)
+  {
+  COUNT_HOT_PATH_IF(allocations, p.capacity() < (size_t)size);
+  p.resize(size);
+  const int step = (int)b.steps.size() - 1;
+  const int nodes = (int)b.steps[step].size();
+  for (int i = 0; i < size; ++i)
+    {
+    if (i < (int)b.solutions.size())
+      p[i] = b.solutions[i];
+    else
+      node_chromosome(p[i], b, step, (i - (int)b.solutions.size()) % nodes);
+    }
+  }
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "cgalgo.h"
+
+#include <stdint.h>
+#include <vector>
+
+/*
+ Beam search over the per step controls. Every step each node of the beam is expanded with
+ beam_moves combinations of an angle and a thrust delta, advanced with simulate, and dropped
+ when its last segment hits the surface or leaves the map. Children that fall in the same cell
+ of a hashed grid over position, speed, angle and thrust are deduplicated, and the width
+ cheapest children by beam_cost form the next step.
+
+ The cost is the distance to the landing zone around the terrain, read from a distance field
+ over a coarse grid where climbing counts extra, at the position the lander drifts to in a few
+ seconds. Speed that can no longer be braked before the ground below or the landing zone is
+ penalized on top.
+ Touch downs in the landing zone that are valid landings by themselves are replayed, and kept as
+ solutions if the chromosome of the node still makes a valid landing after evaluate corrected
+ its final genes (see is_a_valid_landing).
+
+ When the beam dies out or reaches chromosome_size steps, the search starts again from the
+ initial state with twice the width, until it reaches maximum_width.
+ */
+
+#define beam_moves 15
+
+struct beam_node
+  {
+  simulation_data sd;
+  int parent; // index in the previous step, -1 for the initial state
+  gene g; // the deltas that lead from the parent to this node, as in a chromosome
+  float cost; // see beam_cost, smaller is better
+  };
+
+struct beam_search
+  {
+  int width = 1000; // nodes per step of the first search, doubled on every restart
+  int maximum_width = 8000; // the width stops doubling here, every step of the beam is kept in memory
+  int cell_size = 50; // meters per cell of the distance field
+
+  int current_width;
+  int restarts;
+  std::vector<std::vector<beam_node>> steps; // steps[d] holds the beam after d steps
+  population solutions; // chromosomes that make a valid landing
+
+  int columns, rows;
+  std::vector<float> distance; // per cell, meters to the landing zone around the terrain, negative if unreachable
+  std::vector<float> ground; // per cell, height of the surface below the center of the cell
+
+  std::vector<beam_node> children; // scratch
+  std::vector<char> outcomes; // scratch
+  std::vector<std::pair<uint64_t, int>> keys; // scratch
+  std::vector<std::pair<int, chromosome>> landings; // scratch, solutions by child index
+  };
+
+/*
+ Builds the distance field for the current level (see set_level) and starts a search with
+ b.width nodes from the initial state.
+ */
+void init_beam(beam_search& b);
+
+/*
+ Advances the beam by one step.
+ */
+void expand_beam(beam_search& b);
+
+/*
+ Returns the heuristic cost of sd, smaller is better.
+ */
+float beam_cost(const beam_search& b, const simulation_data& sd);
+
+/*
+ Fills p with size chromosomes: the solutions first, then the cheapest nodes of the current step,
+ repeated if the beam holds fewer nodes. The genes after the node are zero, so the lander keeps
+ its last angle and thrust. The memory of p is reused.
+ */
+void beam_population(population& p, const beam_search& b, int size);
@@ -8,12 +8,17 @@
  */
 
 #include "cgalgo.h"
+#include "counters.h"
+#include "parallel.h"
+#include "trace.h"
+
+#include <charconv>
 
 template <class T>
 inline T sqr(T a) { return a*a; }
 
 std::vector<vec2<int>> surface_points;
-RKISS rkiss;
+thread_local RKISS rkiss; // one generator per thread, so that independent runs can be solved in parallel
 int landing_zone_x0, landing_zone_x1, landing_zone_y;
 simulation_data simdata;
 
@@ -69,6 +74,22 @@ int clamp_thrust(int P) {
   return P<0?0:P>maximum_thrust?maximum_thrust:P;
 }
 
+void seed_random(int seed) {
+  rkiss = RKISS(seed);
+}
+
+void get_random_state(uint64_t state[4]) {
+  rkiss.get_state(state);
+}
+
+void set_random_state(const uint64_t state[4]) {
+  rkiss.set_state(state);
+}
+
+uint64_t random_uint64() {
+  return rkiss.rand64();
+}
+
 gene generate_random_gene() {
   gene g;
   g.angle = (int)(rkiss.rand64()%(2*maximum_angle_rotation+1))-maximum_angle_rotation;
@@ -78,6 +99,7 @@ gene generate_random_gene() {
 
 chromosome generate_random_chromosome() {
   chromosome c;
+  COUNT_HOT_PATH(allocations);
   c.reserve(chromosome_size);
   for (int i = 0; i < chromosome_size; ++i) {
     c.push_back(generate_random_gene());
@@ -85,16 +107,18 @@ chromosome generate_random_chromosome() {
   return c;
 }
 
-population generate_random_population() {
+population generate_random_population(int size) {
   population p;
-  p.reserve(population_size);
-  for (int i = 0; i < population_size; ++i) {
+  COUNT_HOT_PATH(allocations);
+  p.reserve(size);
+  for (int i = 0; i < size; ++i) {
     p.emplace_back(generate_random_chromosome());
   }
   return p;
 }
 
 void simulate(simulation_data& sd, int angle, int thrust) {
+  COUNT_HOT_PATH(physics_steps);
   const vec2<float> g(0, -3.711f);
   angle = clamp_angle(angle, sd.R);
   float ang = (float)angle*(float)pi/180.f;
@@ -109,34 +133,115 @@ void simulate(simulation_data& sd, int angle, int thrust) {
   sd.v = sd.v + a;
 }
 
-void read_input(std::stringstream& strcin, std::stringstream& strerr) {
-  surface_points.clear();
+// Converts the offset of pos in script to a "line l, column c" prefix for error messages.
+std::string error_position(std::string_view script, const char* pos) {
+  int line = 1;
+  int column = 1;
+  for (const char* it = script.data(); it < pos; ++it) {
+    if (*it == '\n') {
+      ++line;
+      column = 1;
+    } else
+      ++column;
+  }
+  return "line " + std::to_string(line) + ", column " + std::to_string(column) + ": ";
+}
+
+inline bool is_space(char ch) {
+  return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n';
+}
+
+// Reads the next integer from [it, last) and checks that it lies in [lo, hi].
+bool parse_int(int& value, const char*& it, const char* last, int lo, int hi, const char* name, std::string_view script, std::string& error) {
+  while (it < last && is_space(*it))
+    ++it;
+  if (it == last) {
+    error = error_position(script, it) + "unexpected end of input, expected " + name;
+    return false;
+  }
+  const char* first = it;
+  auto res = std::from_chars(it, last, value);
+  if (res.ec == std::errc::invalid_argument || (res.ptr < last && !is_space(*res.ptr))) {
+    error = error_position(script, first) + "expected an integer for " + name;
+    return false;
+  }
+  if (res.ec == std::errc::result_out_of_range || value < lo || value > hi) {
+    error = error_position(script, first) + name + " " + std::string(first, res.ptr) + " is out of range [" + std::to_string(lo) + ", " + std::to_string(hi) + "]";
+    return false;
+  }
+  it = res.ptr;
+  return true;
+}
+
+bool parse_level(level& lvl, std::string_view script, std::string& error) {
+  const char* it = script.data();
+  const char* last = it + script.size();
+  while (it < last && is_space(*it))
+    ++it;
+  const char* N_pos = it;
   int N; // the number of points used to draw the surface of Mars.
-  strcin >> N; strcin.ignore();
-  strerr << N << std::endl;
+  if (!parse_int(N, it, last, 2, maximum_surface_points, "the number of surface points", script, error))
+    return false;
+  lvl.surface.clear();
+  lvl.surface.reserve(N);
   for (int i = 0; i < N; i++) {
     int landX; // X coordinate of a surface point. (0 to 6999)
     int landY; // Y coordinate of a surface point. By linking all the points together in a sequential fashion, you form the surface of Mars.
-    strcin >> landX >> landY; strcin.ignore();
-    strerr << landX << " " << landY << std::endl;
-    surface_points.emplace_back(landX, landY);
+    if (!parse_int(landX, it, last, 0, W-1, "surface point x", script, error) ||
+        !parse_int(landY, it, last, 0, H-1, "surface point y", script, error))
+      return false;
+    lvl.surface.emplace_back(landX, landY);
+  }
+  int x0, x1, y;
+  find_landingzone(x0, x1, y, lvl.surface);
+  if (x0 == x1) {
+    error = error_position(script, N_pos) + "the surface has no flat landing zone of at least 1000 meters";
+    return false;
+  }
+
+  int X, Y, HS, VS, F, R, P;
+  if (!parse_int(X, it, last, 0, W-1, "X", script, error) ||
+      !parse_int(Y, it, last, 0, H-1, "Y", script, error) ||
+      !parse_int(HS, it, last, -maximum_speed, maximum_speed, "HS", script, error) ||
+      !parse_int(VS, it, last, -maximum_speed, maximum_speed, "VS", script, error) ||
+      !parse_int(F, it, last, 0, maximum_fuel, "F", script, error) ||
+      !parse_int(R, it, last, -maximum_angle, maximum_angle, "R", script, error) ||
+      !parse_int(P, it, last, 0, maximum_thrust, "P", script, error))
+    return false;
+  while (it < last && is_space(*it))
+    ++it;
+  if (it != last) {
+    error = error_position(script, it) + "unexpected characters after the initial state";
+    return false;
   }
+
+  lvl.initial.p = vec2<float>(X,Y);
+  lvl.initial.v = vec2<float>(HS,VS);
+  lvl.initial.F = F;
+  lvl.initial.R = R;
+  lvl.initial.P = P;
+  return true;
+}
+
+void set_level(const level& lvl) {
+  surface_points = lvl.surface;
   find_landingzone(landing_zone_x0, landing_zone_x1, landing_zone_y, surface_points);
-  
-  int X;
-  int Y;
-  int HS; // the horizontal speed (in m/s), can be negative.
-  int VS; // the vertical speed (in m/s), can be negative.
-  int F; // the quantity of remaining fuel in liters.
-  int R; // the rotation angle in degrees (-90 to 90).
-  int P; // the thrust power (0 to 4).
-  strcin >> X >> Y >> HS >> VS >> F >> R >> P;
-  
-  simdata.p = vec2<float>(X,Y);
-  simdata.v = vec2<float>(HS,VS);
-  simdata.F = F;
-  simdata.R = R;
-  simdata.P = P;
+  simdata = lvl.initial;
+}
+
+bool read_input(std::string_view script, std::string& error, std::ostream* log) {
+  level lvl;
+  if (!parse_level(lvl, script, error))
+    return false;
+  if (log) {
+    *log << lvl.surface.size() << std::endl;
+    for (const auto& pt : lvl.surface)
+      *log << pt.x << " " << pt.y << std::endl;
+  }
+  surface_points.swap(lvl.surface);
+  find_landingzone(landing_zone_x0, landing_zone_x1, landing_zone_y, surface_points);
+  simdata = lvl.initial;
+  return true;
 }
 
 // Given three colinear points p, q, r, the function checks if
@@ -213,8 +318,11 @@ bool crashed_or_landed(int X, int Y, int PX, int PY) {
    */
   vec2<int> p2(X,Y), q2(PX,PY);
   for (int i = 1; i < surface_points.size(); ++i) {
-    if (intersects(surface_points[i-1], surface_points[i], p2, q2))
+    COUNT_HOT_PATH(segment_tests);
+    if (intersects(surface_points[i-1], surface_points[i], p2, q2)) {
+      COUNT_HOT_PATH(intersection_hits);
       return true;
+    }
   }
   return false;
 }
@@ -225,8 +333,6 @@ bool crashed_or_landed(int X, int Y, int PX, int PY) {
 #define did_not_reach_solid_ground_multiplier 5
 #define lz_buffer 50
 
-#define GENERATE_PATH
-
 void run_chromosome(simulation_data& sd, simulation_data& prev_sd, const chromosome& c) {
   sd = simdata;
   prev_sd = simdata;
@@ -258,50 +364,17 @@ void run_chromosome(simulation_data& sd, simulation_data& prev_sd, const chromos
 
 #define EVALUATION_A
 
+namespace {
+  vec2<int16_t> to_path_point(int X, int Y) {
+    // the lander can leave the map, keep the point representable
+    return vec2<int16_t>((int16_t)std::max(-32768, std::min(32767, X)), (int16_t)std::max(-32768, std::min(32767, Y)));
+  }
+}
+
 #if defined(EVALUATION_A)
 
-int64_t evaluate(std::vector<vec2<float>>& path, chromosome& c) {
+int64_t score_flight(simulation_data sd, const simulation_data& sd_prev, const simulation_data& sd_prev2, int i, chromosome& c) {
   int64_t score = 0;
-#if defined(GENERATE_PATH)
-  path.clear();
-  path.reserve(chromosome_size);
-#endif
-  simulation_data sd = simdata;
-  simulation_data sd_prev = sd;
-  simulation_data sd_prev2 = sd_prev;
-  bool crashed = false;
-  int PX=(int)std::round(sd.p[0]); // previous X
-  int PY=(int)std::round(sd.p[1]); // previous Y
-  int i = 0;
-  int angle = sd.R;
-  int thrust = sd.P;
-  for (; i < chromosome_size; ++i) {
-    angle += c[i].angle;
-    thrust += c[i].thrust;
-    angle = clamp_angle(angle);
-    thrust = clamp_thrust(thrust);
-    simulate(sd, angle, thrust);
-    int X = (int)std::round(sd.p[0]);
-    int Y = (int)std::round(sd.p[1]);
-    int HS = (int)std::round(sd.v[0]);
-    int VS = (int)std::round(sd.v[1]);
-#if defined(GENERATE_PATH)
-    path.emplace_back(X,Y);
-#endif
-    crashed = crashed_or_landed(X, Y, PX, PY);
-    if (crashed) {
-#if defined(GENERATE_PATH)
-      while (path.size()<chromosome_size)
-        path.emplace_back(X,Y);
-#endif
-      break;
-    }
-    sd_prev2 = sd_prev;
-    sd_prev = sd;
-    PX=X;
-    PY=Y;
-  }
-  
   const int landing_error_penalty = 3000;
   
   if (std::abs(sd_prev2.R)>maximum_angle_rotation) {
@@ -361,14 +434,8 @@ int64_t evaluate(std::vector<vec2<float>>& path, chromosome& c) {
   return score < 0 ? 0 : score;
 }
 
-#elif defined(EVALUATION_B)
-
-int64_t evaluate(std::vector<vec2<float>>& path, chromosome& c) {
-  int64_t score = 0;
-#if defined(GENERATE_PATH)
-  path.clear();
-  path.reserve(chromosome_size);
-#endif
+int64_t evaluate(vec2<int16_t>* path, chromosome& c) {
+  COUNT_HOT_PATH(evaluations);
   simulation_data sd = simdata;
   simulation_data sd_prev = sd;
   simulation_data sd_prev2 = sd_prev;
@@ -388,15 +455,13 @@ int64_t evaluate(std::vector<vec2<float>>& path, chromosome& c) {
     int Y = (int)std::round(sd.p[1]);
     int HS = (int)std::round(sd.v[0]);
     int VS = (int)std::round(sd.v[1]);
-#if defined(GENERATE_PATH)
-    path.emplace_back(X,Y);
-#endif
+    if (path)
+      path[i] = to_path_point(X, Y);
     crashed = crashed_or_landed(X, Y, PX, PY);
     if (crashed) {
-#if defined(GENERATE_PATH)
-      while (path.size()<chromosome_size)
-        path.emplace_back(X,Y);
-#endif
+      COUNT_HOT_PATH_IF(early_exits, i + 1 < chromosome_size);
+      if (path)
+        std::fill(path + i + 1, path + chromosome_size, to_path_point(X, Y));
       break;
     }
     sd_prev2 = sd_prev;
@@ -405,7 +470,13 @@ int64_t evaluate(std::vector<vec2<float>>& path, chromosome& c) {
     PY=Y;
   }
   
-  
+  return score_flight(sd, sd_prev, sd_prev2, i, c);
+}
+
+#elif defined(EVALUATION_B)
+
+int64_t score_flight(simulation_data sd, const simulation_data& sd_prev, const simulation_data& sd_prev2, int i, chromosome& c) {
+  int64_t score = 0;
   const int landing_error_penalty = 3000;
   
   if (std::abs(sd_prev2.R)>maximum_angle_rotation) {
@@ -458,7 +529,71 @@ int64_t evaluate(std::vector<vec2<float>>& path, chromosome& c) {
   return score;
 }
 
+int64_t evaluate(vec2<int16_t>* path, chromosome& c) {
+  COUNT_HOT_PATH(evaluations);
+  simulation_data sd = simdata;
+  simulation_data sd_prev = sd;
+  simulation_data sd_prev2 = sd_prev;
+  bool crashed = false;
+  int PX=(int)std::round(sd.p[0]); // previous X
+  int PY=(int)std::round(sd.p[1]); // previous Y
+  int i = 0;
+  int angle = sd.R;
+  int thrust = sd.P;
+  for (; i < chromosome_size; ++i) {
+    angle += c[i].angle;
+    thrust += c[i].thrust;
+    angle = clamp_angle(angle);
+    thrust = clamp_thrust(thrust);
+    simulate(sd, angle, thrust);
+    int X = (int)std::round(sd.p[0]);
+    int Y = (int)std::round(sd.p[1]);
+    int HS = (int)std::round(sd.v[0]);
+    int VS = (int)std::round(sd.v[1]);
+    if (path)
+      path[i] = to_path_point(X, Y);
+    crashed = crashed_or_landed(X, Y, PX, PY);
+    if (crashed) {
+      COUNT_HOT_PATH_IF(early_exits, i + 1 < chromosome_size);
+      if (path)
+        std::fill(path + i + 1, path + chromosome_size, to_path_point(X, Y));
+      break;
+    }
+    sd_prev2 = sd_prev;
+    sd_prev = sd;
+    PX=X;
+    PY=Y;
+  }
+  
+  return score_flight(sd, sd_prev, sd_prev2, i, c);
+}
+
+#endif
+
+std::string build_configuration() {
+  std::stringstream str;
+#if defined(EVALUATION_A)
+  str << "EVALUATION_A";
+#elif defined(EVALUATION_B)
+  str << "EVALUATION_B";
+#endif
+#if defined(OUTOFBOUNDSCLAMPING)
+  str << " OUTOFBOUNDSCLAMPING";
+#endif
+  str << " chromosome_size=" << chromosome_size << " W=" << W << " H=" << H
+    << " maximum_vertical_speed=" << maximum_vertical_speed << " maximum_horizontal_speed=" << maximum_horizontal_speed
+    << " maximum_angle_rotation=" << maximum_angle_rotation << " maximum_angle=" << maximum_angle
+    << " maximum_thrust=" << maximum_thrust << " maximum_thrust_change=" << maximum_thrust_change;
+  return str.str();
+}
+
+bool is_better_score(int64_t left, int64_t right) {
+#if defined(EVALUATION_A)
+  return left > right;
+#else
+  return left < right;
 #endif
+}
 
 bool is_a_valid_landing(const simulation_data& sd, const simulation_data& prev_sd) {
   if (sd.R != 0)
@@ -478,7 +613,46 @@ bool is_a_valid_landing(const simulation_data& sd, const simulation_data& prev_s
   return true;
 }
 
+int number_of_threads = (int)std::max(1u, std::thread::hardware_concurrency());
+
+void evaluate_population(std::vector<int64_t>& scores, population& p, std::vector<vec2<int16_t>>* paths) {
+  COUNT_HOT_PATH_IF(allocations, scores.capacity() < p.size());
+  scores.resize(p.size());
+  if (paths) {
+    COUNT_HOT_PATH_IF(allocations, paths->capacity() < p.size() * chromosome_size);
+    paths->resize(p.size() * chromosome_size);
+  }
+#if defined(MARSLANDER_COUNTERS)
+  hot_path_counters sum = hot_path_counters();
+  std::mutex sum_mutex;
+#endif
+  parallel_for((int)p.size(), number_of_threads, [&](int first, int last) {
+    trace_scope trace("evaluation chunk");
+#if defined(MARSLANDER_COUNTERS)
+    hot_path_chunk chunk(sum, sum_mutex);
+#endif
+    for (int i = first; i < last; ++i)
+      scores[i] = evaluate(paths ? paths->data() + (size_t)i * chromosome_size : nullptr, p[i]);
+  });
+#if defined(MARSLANDER_COUNTERS)
+  add(thread_counters, sum);
+#endif
+}
+
+int get_best_index(const std::vector<double>& normalized_score) {
+  int besti = 0;
+  double score = 0.0;
+  for (int i = 0; i < normalized_score.size(); ++i) {
+    if (normalized_score[i] > score) {
+      score = normalized_score[i];
+      besti = i;
+    }
+  }
+  return besti;
+}
+
 void normalize_scores_roulette_wheel(std::vector<double>& out, const std::vector<int64_t>& score) {
+  trace_scope trace("normalize_scores_roulette_wheel");
 #if defined(EVALUATION_B)
   int64_t M = *std::max_element(score.begin(), score.end());
 #endif
@@ -489,7 +663,10 @@ void normalize_scores_roulette_wheel(std::vector<double>& out, const std::vector
 #elif defined(EVALUATION_B)
   sum += (int64_t)(M-s);
 #endif
-  static std::vector<std::pair<double, int>> temp(score.size());
+  thread_local std::vector<std::pair<double, int>> temp;
+  COUNT_HOT_PATH_IF(allocations, temp.capacity() < score.size());
+  if (temp.size() != score.size())
+    temp.resize(score.size());
   for (int i = 0; i < score.size(); ++i) {
 #if defined(EVALUATION_A)
     double new_score = (double)(score[i])/(double)sum;
@@ -499,6 +676,7 @@ void normalize_scores_roulette_wheel(std::vector<double>& out, const std::vector
     temp[i] = std::pair<double, int>(new_score, i);
   }
   std::sort(temp.begin(), temp.end(), [](const auto& left, const auto& right) { return left.first > right.first;});
+  COUNT_HOT_PATH_IF(allocations, out.capacity() < score.size());
   if (out.size() != score.size())
     out.resize(score.size());
   
@@ -518,25 +696,28 @@ inline double rand_double() {
   return (double)(rkiss.rand64()%100000)/100000.0;
 }
 
-void make_children(chromosome& child1, chromosome& child2, const chromosome& parent1, const chromosome& parent2) {
-  if (child1.size() != chromosome_size)
-    child1.resize(chromosome_size);
-  if (child2.size() != chromosome_size)
-    child2.resize(chromosome_size);
+void make_children(chromosome& child1, chromosome& child2, const chromosome& parent1, const chromosome& parent2, gene (*random_gene)()) {
+  const size_t size = parent1.size(); // chromosome_size, unless the genes hold for several steps
+  COUNT_HOT_PATH_IF(allocations, child1.capacity() < size);
+  COUNT_HOT_PATH_IF(allocations, child2.capacity() < size);
+  if (child1.size() != size)
+    child1.resize(size);
+  if (child2.size() != size)
+    child2.resize(size);
   double r = rand_double();
   double r2 = 1.0-r;
-  for (int i = 0; i < chromosome_size; ++i) {
+  for (int i = 0; i < size; ++i) {
     gene g1, g2;
     double r3 = rand_double();
     if (r3 < mutation_chance)
-      g1 = generate_random_gene();
+      g1 = random_gene();
     else {
       g1.angle = (int)std::round(parent1[i].angle*r+parent2[i].angle*r2);
       g1.thrust = (int)std::round(parent1[i].thrust*r+parent2[i].thrust*r2);
     }
     double r4 = rand_double();
     if (r4 < mutation_chance)
-      g2 = generate_random_gene();
+      g2 = random_gene();
     else {
       g2.angle = std::round(parent1[i].angle*r2+parent2[i].angle*r);
       g2.thrust = std::round(parent1[i].thrust*r2+parent2[i].thrust*r);
@@ -548,10 +729,13 @@ void make_children(chromosome& child1, chromosome& child2, const chromosome& par
   }
 }
 
-void make_next_generation(population& new_pop, const population& current, const std::vector<double>& score) {
+void make_next_generation(population& new_pop, const population& current, const std::vector<double>& score, gene (*random_gene)()) {
+  trace_scope trace("make_next_generation");
+  COUNT_HOT_PATH_IF(allocations, new_pop.capacity() < current.size());
   if (new_pop.size() != current.size())
     new_pop.resize(current.size());
-  static std::vector<std::pair<double, int>> score_index;
+  thread_local std::vector<std::pair<double, int>> score_index;
+  COUNT_HOT_PATH_IF(allocations, score_index.capacity() < score.size());
   if (score_index.size() != score.size())
     score_index.resize(score.size());
   for (int i = 0; i < score.size(); ++i)
@@ -562,6 +746,7 @@ void make_next_generation(population& new_pop, const population& current, const
     ++elitair_chromosomes_to_copy;
   
   for (int i=0; i < elitair_chromosomes_to_copy; ++i) {
+    COUNT_HOT_PATH_IF(allocations, new_pop[i].capacity() < current[score_index[i].second].size());
     new_pop[i] = current[score_index[i].second];
   }
   
@@ -583,7 +768,7 @@ void make_next_generation(population& new_pop, const population& current, const
       --idx;
       second_parent_index = score_index[idx].second;
     }
-    make_children(new_pop[2*i+elitair_chromosomes_to_copy], new_pop[2*i+1+elitair_chromosomes_to_copy], current[first_parent_index], current[second_parent_index]);
+    make_children(new_pop[2*i+elitair_chromosomes_to_copy], new_pop[2*i+1+elitair_chromosomes_to_copy], current[first_parent_index], current[second_parent_index], random_gene);
   }
   
 }
@@ -6,6 +6,7 @@
 #include <algorithm>
 #include <cmath>
 #include <sstream>
+#include <string_view>
 
 #define pi 3.1415926535897f
 
@@ -19,6 +20,10 @@
 #define maximum_angle 90
 #define maximum_thrust 4
 #define maximum_thrust_change 1
+// input limits of a level, see parse_level
+#define maximum_surface_points W
+#define maximum_speed 500
+#define maximum_fuel 2000
 
 // random number generator
 class RKISS {
@@ -45,6 +50,14 @@ public:
   }
   
   template<typename T> T rand() { return T(rand64()); }
+
+  void get_state(uint64_t state[4]) const {
+    state[0] = a, state[1] = b, state[2] = c, state[3] = d;
+  }
+
+  void set_state(const uint64_t state[4]) {
+    a = state[0], b = state[1], c = state[2], d = state[3];
+  }
 };
 
 
@@ -279,6 +292,11 @@ struct gene {
   int thrust;
 };
 
+struct level {
+  std::vector<vec2<int>> surface;
+  simulation_data initial;
+};
+
 typedef std::vector<gene> chromosome;
 typedef std::vector<chromosome> population;
 
@@ -289,28 +307,111 @@ extern int landing_zone_y;
 extern simulation_data simdata;
 extern double elitarism_factor;
 extern double mutation_chance;
+extern int number_of_threads; // threads used by evaluate_population
+
+/*
+ Describes the compile time choices that change the results of the solver:
+ the evaluation function, the sizes and the physical limits.
+ */
+std::string build_configuration();
+
+/*
+ Resets the random number generator of the calling thread.
+ Every thread starts with the generator RKISS(73).
+ */
+void seed_random(int seed);
+
+/*
+ Saves and restores the state of the random number generator of the calling thread,
+ so that a search can be continued exactly where it stopped.
+ */
+void get_random_state(uint64_t state[4]);
+void set_random_state(const uint64_t state[4]);
+
+/*
+ Draws from the random number generator of the calling thread, for search engines outside this file.
+ */
+uint64_t random_uint64();
 
 chromosome generate_random_chromosome();
-population generate_random_population();
+population generate_random_population(int size = population_size);
 gene generate_random_gene();
 
+/*
+ Finds the first flat segment of at least 1000 meters in pts.
+ x0 == x1 == 0 if there is none.
+ */
+void find_landingzone(int& x0, int& x1, int& y, const std::vector<vec2<int>>& pts);
+
 bool is_a_valid_landing(const simulation_data& sd, const simulation_data& sd_prev);
 
 /*
- This method fills surface_points with the terrain,
- generates heights, which for each pixel x provides the height h,
+ Parses a level in the Coding Games input format without copying the text.
+ Point counts and coordinate ranges are validated. On failure false is returned
+ and error holds the line and column of the offending token.
+ */
+bool parse_level(level& lvl, std::string_view script, std::string& error);
+
+/*
+ This method fills surface_points with the terrain of lvl,
  generates the landing zone interval [landing_zone_x0, landing_zone_x1],
  and fills simdata with the input data for the mars lander.
  */
-void read_input(std::stringstream& strcin, std::stringstream& strerr);
+void set_level(const level& lvl);
+
+/*
+ Parses script and makes it the current level (see parse_level and set_level).
+ The parsed input is echoed to log only if log is not null.
+ */
+bool read_input(std::string_view script, std::string& error, std::ostream* log = nullptr);
+
+/*
+ Advances sd by one second with the given target angle and thrust.
+ */
+void simulate(simulation_data& sd, int angle, int thrust);
+
+bool intersects(const vec2<int>& p1, const vec2<int>& q1, const vec2<int>& p2, const vec2<int>& q2);
+
+/*
+ Returns true if the segment from (PX, PY) to (X, Y) hits the surface.
+ */
+bool crashed_or_landed(int X, int Y, int PX, int PY);
 
 void run_chromosome(simulation_data& sd, simulation_data& prev_sd, const chromosome& c);
 
 /*
  Returns a score. Larger score is bad.
- Also computes the path that is followed as an aux tool for rendering.
+ If path is not null, it receives the chromosome_size positions that are visited, as an aux
+ tool for rendering. After a crash the crash position is repeated.
+ The final genes of c are corrected for a vertical landing, so the path is the trajectory
+ that was scored, not necessarily the one c flies after evaluation.
+ */
+int64_t evaluate(vec2<int16_t>* path, chromosome& c);
+
+/*
+ The score of evaluate for a flight that ended with sd, after prev_sd and prev_sd2, where step is
+ the index of the gene that hit the surface, or chromosome_size if none did. Corrects the final genes of c.
+ Exposed for encodings that fly c in another way, see macro_engine.h.
+ */
+int64_t score_flight(simulation_data sd, const simulation_data& prev_sd, const simulation_data& prev_sd2, int step, chromosome& c);
+
+/*
+ Returns true if score left is better than score right. Which direction is better
+ depends on the evaluation function of the build, see build_configuration.
+ */
+bool is_better_score(int64_t left, int64_t right);
+
+/*
+ Evaluates every chromosome of p, scores[i] receives the score of p[i].
+ The population is split over number_of_threads threads.
+ If paths is not null, the path of p[i] is written to (*paths)[i*chromosome_size], see evaluate.
+ */
+void evaluate_population(std::vector<int64_t>& scores, population& p, std::vector<vec2<int16_t>>* paths = nullptr);
+
+/*
+ Returns the index of the chromosome with the best normalized score.
  */
-int64_t evaluate(std::vector<vec2<float>>& path, chromosome& c);
+int get_best_index(const std::vector<double>& normalized_score);
 
 /*
  Converts the scores to a normalized score between 0 and 1.
@@ -318,4 +419,7 @@ int64_t evaluate(std::vector<vec2<float>>& path, chromosome& c);
  */
 void normalize_scores_roulette_wheel(std::vector<double>& out, const std::vector<int64_t>& score);
 
-void make_next_generation(population& next, const population& current, const std::vector<double>& score);
+/*
+ Mutated genes are drawn from random_gene.
+ */
+void make_next_generation(population& next, const population& current, const std::vector<double>& score, gene (*random_gene)() = generate_random_gene);
@@ -0,0 +1,295 @@
+#include "checkpoint.h"
+#include "solver.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace
+  {
+  const char checkpoint_magic[8] = { 'M', 'L', 'C', 'H', 'E', 'C', 'K', 'P' };
+  const uint32_t byte_order_mark = 0x01020304;
+
+  void hash_bytes(uint64_t& h, const void* data, size_t size)
+    {
+    const unsigned char* p = (const unsigned char*)data;
+    for (size_t i = 0; i < size; ++i)
+      {
+      h ^= p[i];
+      h *= 1099511628211ull;
+      }
+    }
+
+  bool encode(std::vector<char>& out, const checkpoint& c, std::string& error)
+    {
+    const size_t length = c.current_population.empty() ? 0 : c.current_population.front().size();
+    checkpoint_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, checkpoint_magic, sizeof(checkpoint_magic));
+    header.version = checkpoint_version;
+    header.generation = (uint32_t)c.generation;
+    header.number_of_chromosomes = (uint32_t)c.current_population.size();
+    header.chromosome_length = (uint32_t)length;
+    header.number_of_points = (uint32_t)c.lvl.surface.size();
+    header.byte_order = byte_order_mark;
+    memcpy(header.random_state, c.random_state, sizeof(header.random_state));
+    header.elitarism_factor = c.elitarism_factor;
+    header.mutation_chance = c.mutation_chance;
+
+    std::vector<int16_t> lvl;
+    lvl.reserve(7 + 2 * c.lvl.surface.size());
+    lvl.push_back((int16_t)std::round(c.lvl.initial.p.x));
+    lvl.push_back((int16_t)std::round(c.lvl.initial.p.y));
+    lvl.push_back((int16_t)std::round(c.lvl.initial.v.x));
+    lvl.push_back((int16_t)std::round(c.lvl.initial.v.y));
+    lvl.push_back((int16_t)c.lvl.initial.F);
+    lvl.push_back((int16_t)c.lvl.initial.R);
+    lvl.push_back((int16_t)c.lvl.initial.P);
+    for (const auto& pt : c.lvl.surface)
+      {
+      lvl.push_back((int16_t)pt.x);
+      lvl.push_back((int16_t)pt.y);
+      }
+
+    const size_t genes_offset = sizeof(header) + lvl.size() * sizeof(int16_t);
+    const size_t scores_offset = genes_offset + c.current_population.size() * length * 2;
+    out.resize(scores_offset + c.scores.size() * sizeof(int64_t) + sizeof(uint64_t));
+    memcpy(out.data(), &header, sizeof(header));
+    memcpy(out.data() + sizeof(header), lvl.data(), lvl.size() * sizeof(int16_t));
+    int8_t* genes = (int8_t*)(out.data() + genes_offset);
+    for (const chromosome& ch : c.current_population)
+      {
+      if (ch.size() != length)
+        {
+        error = "the chromosomes differ in length";
+        return false;
+        }
+      for (const gene& g : ch)
+        {
+        if (g.angle < -128 || g.angle > 127 || g.thrust < -128 || g.thrust > 127)
+          {
+          error = "a gene does not fit in a byte";
+          return false;
+          }
+        *genes++ = (int8_t)g.angle;
+        *genes++ = (int8_t)g.thrust;
+        }
+      }
+    memcpy(out.data() + scores_offset, c.scores.data(), c.scores.size() * sizeof(int64_t));
+    uint64_t h = 14695981039346656037ull;
+    hash_bytes(h, out.data(), out.size() - sizeof(uint64_t));
+    memcpy(out.data() + out.size() - sizeof(uint64_t), &h, sizeof(uint64_t));
+    return true;
+    }
+  }
+
+void make_checkpoint(checkpoint& c, const solver& s)
+  {
+  c.lvl.surface = surface_points;
+  c.lvl.initial = simdata;
+  c.generation = s.generation;
+  c.elitarism_factor = elitarism_factor;
+  c.mutation_chance = mutation_chance;
+  get_random_state(c.random_state);
+  c.current_population = s.current_population;
+  c.scores = s.scores;
+  }
+
+void restore_solver(solver& s, const checkpoint& c)
+  {
+  s.current_population = c.current_population;
+  s.next_population.clear();
+  s.scores = c.scores;
+  normalize_scores_roulette_wheel(s.current_population_normalized_score, s.scores);
+  s.generation = c.generation;
+  }
+
+void resume_solver(solver& s, const checkpoint& c)
+  {
+  set_level(c.lvl);
+  elitarism_factor = c.elitarism_factor;
+  mutation_chance = c.mutation_chance;
+  set_random_state(c.random_state);
+  restore_solver(s, c);
+  }
+
+bool write_checkpoint(const char* filename, const checkpoint& c, std::string& error)
+  {
+  std::vector<char> data;
+  if (!encode(data, c, error))
+    return false;
+  const std::string temporary = std::string(filename) + ".tmp";
+    {
+    std::ofstream f(temporary, std::ios::binary | std::ios::trunc);
+    if (!f.is_open())
+      {
+      error = "cannot create " + temporary;
+      return false;
+      }
+    f.write(data.data(), data.size());
+    f.flush();
+    if (!f)
+      {
+      error = "cannot write " + temporary;
+      return false;
+      }
+    }
+  std::error_code ec;
+  std::filesystem::rename(temporary, filename, ec);
+  if (ec)
+    {
+    error = "cannot rename " + temporary + " to " + filename + ": " + ec.message();
+    return false;
+    }
+  return true;
+  }
+
+bool read_checkpoint(checkpoint& c, const char* filename, std::string& error)
+  {
+  std::ifstream f(filename, std::ios::binary);
+  if (!f.is_open())
+    {
+    error = std::string("cannot open ") + filename;
+    return false;
+    }
+  const std::vector<char> data((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+  checkpoint_header header;
+  if (data.size() < sizeof(header) + sizeof(uint64_t))
+    {
+    error = std::string(filename) + " is not a checkpoint";
+    return false;
+    }
+  memcpy(&header, data.data(), sizeof(header));
+  if (memcmp(header.magic, checkpoint_magic, sizeof(checkpoint_magic)) != 0 || header.version != checkpoint_version)
+    {
+    error = std::string(filename) + " is not a checkpoint of version " + std::to_string(checkpoint_version);
+    return false;
+    }
+  if (header.byte_order != byte_order_mark)
+    {
+    error = std::string(filename) + " was written with a different byte order";
+    return false;
+    }
+  const uint64_t level_size = (7 + 2 * (uint64_t)header.number_of_points) * sizeof(int16_t);
+  const uint64_t genes_size = (uint64_t)header.number_of_chromosomes * header.chromosome_length * 2;
+  const uint64_t scores_size = (uint64_t)header.number_of_chromosomes * sizeof(int64_t);
+  if (data.size() != sizeof(header) + level_size + genes_size + scores_size + sizeof(uint64_t))
+    {
+    error = std::string(filename) + " is truncated";
+    return false;
+    }
+  uint64_t h = 14695981039346656037ull, stored;
+  hash_bytes(h, data.data(), data.size() - sizeof(uint64_t));
+  memcpy(&stored, data.data() + data.size() - sizeof(uint64_t), sizeof(uint64_t));
+  if (h != stored)
+    {
+    error = std::string(filename) + " is corrupt";
+    return false;
+    }
+
+  std::vector<int16_t> lvl(level_size / sizeof(int16_t));
+  memcpy(lvl.data(), data.data() + sizeof(header), level_size);
+  c.lvl.initial.p = vec2<float>(lvl[0], lvl[1]);
+  c.lvl.initial.v = vec2<float>(lvl[2], lvl[3]);
+  c.lvl.initial.F = lvl[4];
+  c.lvl.initial.R = lvl[5];
+  c.lvl.initial.P = lvl[6];
+  c.lvl.surface.resize(header.number_of_points);
+  for (uint32_t i = 0; i < header.number_of_points; ++i)
+    c.lvl.surface[i] = vec2<int>(lvl[7 + 2 * i], lvl[8 + 2 * i]);
+
+  const int8_t* genes = (const int8_t*)(data.data() + sizeof(header) + level_size);
+  c.current_population.resize(header.number_of_chromosomes);
+  for (chromosome& ch : c.current_population)
+    {
+    ch.resize(header.chromosome_length);
+    for (gene& g : ch)
+      {
+      g.angle = *genes++;
+      g.thrust = *genes++;
+      }
+    }
+  c.scores.resize(header.number_of_chromosomes);
+  memcpy(c.scores.data(), data.data() + sizeof(header) + level_size + genes_size, scores_size);
+  c.generation = (int)header.generation;
+  c.elitarism_factor = header.elitarism_factor;
+  c.mutation_chance = header.mutation_chance;
+  memcpy(c.random_state, header.random_state, sizeof(c.random_state));
+  return true;
+  }
+
+checkpoint_writer::checkpoint_writer() : _has_pending(false), _quit(false)
+  {
+  }
+
+checkpoint_writer::~checkpoint_writer()
+  {
+  close();
+  }
+
+void checkpoint_writer::open(const char* filename)
+  {
+  close();
+  _filename = filename;
+  _has_pending = false;
+  _quit = false;
+  _thread = std::thread(&checkpoint_writer::_run, this);
+  }
+
+void checkpoint_writer::close()
+  {
+  if (_thread.joinable())
+    {
+      {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _quit = true;
+      }
+    _wake_up.notify_one();
+    _thread.join();
+    }
+  }
+
+void checkpoint_writer::push(const solver& s)
+  {
+    {
+    std::lock_guard<std::mutex> lock(_mutex);
+    make_checkpoint(_pending, s);
+    _has_pending = true;
+    }
+  _wake_up.notify_one();
+  }
+
+std::string checkpoint_writer::take_error()
+  {
+  std::lock_guard<std::mutex> lock(_mutex);
+  std::string error;
+  std::swap(error, _error);
+  return error;
+  }
+
+void checkpoint_writer::_run()
+  {
+  for (;;)
+    {
+    bool quit, write;
+      {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _wake_up.wait(lock, [this]() { return _quit || _has_pending; });
+      // swapping keeps the memory of both checkpoints, so push does not allocate
+      write = _has_pending;
+      if (write)
+        std::swap(_pending, _writing);
+      _has_pending = false;
+      quit = _quit;
+      }
+    std::string error;
+    if (write && !write_checkpoint(_filename.c_str(), _writing, error))
+      {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _error = error;
+      }
+    if (quit)
+      break;
+    }
+  }
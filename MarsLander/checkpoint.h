@@ -0,0 +1,118 @@
+#pragma once
+
+#include "cgalgo.h"
+
+#include <stdint.h>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct solver;
+
+/*
+ Binary checkpoint file (all values in the native byte order, which header.byte_order records):
+   header     : checkpoint_header
+   level      : int16 initial[7] = {X, Y, HS, VS, F, R, P} followed by int16 {x, y} per surface point, as in a corpus
+   population : int8 {angle, thrust} per gene, chromosome after chromosome
+   scores     : int64 per chromosome
+   checksum   : uint64 FNV-1a hash of everything before
+ */
+#define checkpoint_version 2
+
+struct checkpoint_header
+  {
+  char magic[8];
+  uint32_t version;
+  uint32_t generation;
+  uint32_t number_of_chromosomes;
+  uint32_t chromosome_length;
+  uint32_t number_of_points;
+  uint32_t byte_order; // 0x01020304 as written by the machine that made the checkpoint
+  uint64_t random_state[4];
+  double elitarism_factor;
+  double mutation_chance;
+  };
+
+/*
+ Everything needed to continue a search exactly where it stopped.
+ */
+struct checkpoint
+  {
+  level lvl;
+  int generation;
+  double elitarism_factor;
+  double mutation_chance;
+  uint64_t random_state[4]; // of the thread that runs the generations, see get_random_state
+  population current_population;
+  std::vector<int64_t> scores;
+  };
+
+/*
+ Copies the current generation of s, the current level and parameters and the random
+ generator of the calling thread into c. Reuses the memory of c.
+ */
+void make_checkpoint(checkpoint& c, const solver& s);
+
+/*
+ Copies the population, the scores and the generation of c into s and normalizes the scores.
+ The level, the parameters and the random generator are left alone, see resume_solver.
+ */
+void restore_solver(solver& s, const checkpoint& c);
+
+/*
+ Makes the level and the parameters of c current, restores the random generator of the
+ calling thread and continues s from c. The next run_generation on this thread produces
+ the same generation as the run that wrote c.
+ */
+void resume_solver(solver& s, const checkpoint& c);
+
+/*
+ Writes c to a temporary file next to filename and renames it, so that filename
+ always holds a complete checkpoint, even if the process is killed while writing.
+ */
+bool write_checkpoint(const char* filename, const checkpoint& c, std::string& error);
+
+bool read_checkpoint(checkpoint& c, const char* filename, std::string& error);
+
+/*
+ Writes checkpoints on a background thread. push only copies the generation, so the solver
+ never waits for the disk. If push is called again before the previous checkpoint is written,
+ only the newest one is written.
+ */
+class checkpoint_writer
+  {
+  public:
+    checkpoint_writer();
+    ~checkpoint_writer();
+    checkpoint_writer(const checkpoint_writer&) = delete;
+    void operator=(const checkpoint_writer&) = delete;
+
+    void open(const char* filename);
+
+    // Writes the pending checkpoint and stops the background thread.
+    void close();
+
+    bool is_open() const { return _thread.joinable(); }
+
+    const std::string& filename() const { return _filename; }
+
+    // Takes a checkpoint of s on the calling thread, see make_checkpoint.
+    void push(const solver& s);
+
+    // Returns the error of the last checkpoint that could not be written, and forgets it.
+    std::string take_error();
+
+  private:
+    void _run();
+
+  private:
+    std::string _filename;
+    std::string _error;
+    checkpoint _pending, _writing;
+    bool _has_pending;
+    bool _quit;
+    std::thread _thread;
+    std::mutex _mutex;
+    std::condition_variable _wake_up;
+  };
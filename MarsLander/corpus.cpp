@@ -0,0 +1,302 @@
+#include "corpus.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+  {
+  const char corpus_magic[8] = { 'M', 'L', 'C', 'O', 'R', 'P', 'U', 'S' };
+  const uint32_t byte_order_mark = 0x01020304;
+  }
+
+corpus::corpus() : _data(nullptr), _data_size(0), _index(nullptr), _number_of_levels(0)
+#ifdef _WIN32
+, _file(INVALID_HANDLE_VALUE), _mapping(nullptr)
+#else
+, _fd(-1)
+#endif
+  {
+  }
+
+corpus::~corpus()
+  {
+  close();
+  }
+
+bool corpus::open(const char* filename, std::string& error)
+  {
+  close();
+#ifdef _WIN32
+  _file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL);
+  if (_file == INVALID_HANDLE_VALUE)
+    {
+    error = std::string("cannot open ") + filename;
+    return false;
+    }
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(_file, &file_size))
+    {
+    error = std::string("cannot read the size of ") + filename;
+    close();
+    return false;
+    }
+  _data_size = (uint64_t)file_size.QuadPart;
+  if (_data_size >= sizeof(corpus_header))
+    {
+    _mapping = CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (_mapping)
+      _data = (const char*)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+    }
+#else
+  _fd = ::open(filename, O_RDONLY);
+  if (_fd < 0)
+    {
+    error = std::string("cannot open ") + filename;
+    return false;
+    }
+  struct stat st;
+  if (fstat(_fd, &st) != 0)
+    {
+    error = std::string("cannot read the size of ") + filename;
+    close();
+    return false;
+    }
+  _data_size = (uint64_t)st.st_size;
+  if (_data_size >= sizeof(corpus_header))
+    {
+    void* p = mmap(nullptr, (size_t)_data_size, PROT_READ, MAP_SHARED, _fd, 0);
+    if (p != MAP_FAILED)
+      _data = (const char*)p;
+    }
+#endif
+  if (!_data)
+    {
+    error = std::string(filename) + " is not a level corpus";
+    close();
+    return false;
+    }
+  const corpus_header* header = (const corpus_header*)_data;
+  if (memcmp(header->magic, corpus_magic, sizeof(corpus_magic)) != 0 || header->version != corpus_version)
+    {
+    error = std::string(filename) + " is not a level corpus of version " + std::to_string(corpus_version);
+    close();
+    return false;
+    }
+  if (header->byte_order != byte_order_mark)
+    {
+    error = std::string(filename) + " was written with a different byte order";
+    close();
+    return false;
+    }
+  const uint64_t index_size = ((uint64_t)header->number_of_levels + 1) * sizeof(uint64_t);
+  if (header->index_offset % sizeof(uint64_t) != 0 || header->index_offset > _data_size || _data_size - header->index_offset < index_size)
+    {
+    error = std::string(filename) + " has a corrupt index";
+    close();
+    return false;
+    }
+  _index = (const uint64_t*)(_data + header->index_offset);
+  // Only the index is validated here, so that opening the corpus does not touch the level records.
+  const uint64_t minimum_record_size = (7 + 2 * 2) * sizeof(int16_t);
+  for (uint32_t i = 0; i < header->number_of_levels; ++i)
+    {
+    const uint64_t record_size = _index[i + 1] - _index[i];
+    if (_index[i] < sizeof(corpus_header) || _index[i + 1] > header->index_offset || _index[i + 1] < _index[i] ||
+      _index[i] % sizeof(int16_t) != 0 || record_size < minimum_record_size || (record_size - 7 * sizeof(int16_t)) % (2 * sizeof(int16_t)) != 0)
+      {
+      error = std::string(filename) + " has a corrupt record for level " + std::to_string(i);
+      close();
+      return false;
+      }
+    }
+  _number_of_levels = header->number_of_levels;
+  return true;
+  }
+
+void corpus::close()
+  {
+#ifdef _WIN32
+  if (_data)
+    UnmapViewOfFile(_data);
+  if (_mapping)
+    CloseHandle(_mapping);
+  if (_file != INVALID_HANDLE_VALUE)
+    CloseHandle(_file);
+  _mapping = nullptr;
+  _file = INVALID_HANDLE_VALUE;
+#else
+  if (_data)
+    munmap((void*)_data, (size_t)_data_size);
+  if (_fd >= 0)
+    ::close(_fd);
+  _fd = -1;
+#endif
+  _data = nullptr;
+  _data_size = 0;
+  _index = nullptr;
+  _number_of_levels = 0;
+  }
+
+corpus_level corpus::operator [] (uint32_t i) const
+  {
+  corpus_level lvl;
+  lvl.initial = (const int16_t*)(_data + _index[i]);
+  lvl.points = lvl.initial + 7;
+  lvl.number_of_points = (int)((_index[i + 1] - _index[i] - 7 * sizeof(int16_t)) / (2 * sizeof(int16_t)));
+  return lvl;
+  }
+
+corpus_writer::corpus_writer() : _position(0)
+  {
+  }
+
+corpus_writer::~corpus_writer()
+  {
+  std::string error;
+  if (_f.is_open())
+    close(error);
+  }
+
+bool corpus_writer::open(const char* filename, std::string& error)
+  {
+  _f.open(filename, std::ios::binary | std::ios::trunc);
+  if (!_f.is_open())
+    {
+    error = std::string("cannot create ") + filename;
+    return false;
+    }
+  _offsets.clear();
+  corpus_header header;
+  memset(&header, 0, sizeof(header));
+  _f.write((const char*)&header, sizeof(header)); // patched in close
+  _position = sizeof(header);
+  return true;
+  }
+
+void corpus_writer::add(const level& lvl)
+  {
+  std::vector<int16_t> record;
+  record.reserve(7 + 2 * lvl.surface.size());
+  record.push_back((int16_t)std::round(lvl.initial.p.x));
+  record.push_back((int16_t)std::round(lvl.initial.p.y));
+  record.push_back((int16_t)std::round(lvl.initial.v.x));
+  record.push_back((int16_t)std::round(lvl.initial.v.y));
+  record.push_back((int16_t)lvl.initial.F);
+  record.push_back((int16_t)lvl.initial.R);
+  record.push_back((int16_t)lvl.initial.P);
+  for (const auto& pt : lvl.surface)
+    {
+    record.push_back((int16_t)pt.x);
+    record.push_back((int16_t)pt.y);
+    }
+  _offsets.push_back(_position);
+  _f.write((const char*)record.data(), record.size() * sizeof(int16_t));
+  _position += record.size() * sizeof(int16_t);
+  }
+
+bool corpus_writer::close(std::string& error)
+  {
+  _offsets.push_back(_position); // end of the last record
+  // align the index on 8 bytes
+  while (_position % sizeof(uint64_t))
+    {
+    _f.put(0);
+    ++_position;
+    }
+  corpus_header header;
+  memcpy(header.magic, corpus_magic, sizeof(corpus_magic));
+  header.version = corpus_version;
+  header.number_of_levels = (uint32_t)_offsets.size() - 1;
+  header.index_offset = _position;
+  header.byte_order = byte_order_mark;
+  header.reserved = 0;
+  _f.write((const char*)_offsets.data(), _offsets.size() * sizeof(uint64_t));
+  _f.seekp(0);
+  _f.write((const char*)&header, sizeof(header));
+  _f.close();
+  _offsets.clear();
+  if (_f.fail())
+    {
+    error = "writing the corpus failed";
+    return false;
+    }
+  return true;
+  }
+
+bool validate_level(const corpus_level& lvl, std::string& error)
+  {
+  if (lvl.number_of_points < 2 || lvl.number_of_points > maximum_surface_points)
+    {
+    error = "the number of surface points " + std::to_string(lvl.number_of_points) + " is out of range";
+    return false;
+    }
+  bool landing_zone = false;
+  for (int i = 0; i < lvl.number_of_points; ++i)
+    {
+    const int x = lvl.points[2 * i];
+    const int y = lvl.points[2 * i + 1];
+    if (x < 0 || x > W - 1 || y < 0 || y > H - 1)
+      {
+      error = "surface point " + std::to_string(i) + " is out of range";
+      return false;
+      }
+    if (i > 0 && y == lvl.points[2 * i - 1] && std::abs(x - lvl.points[2 * i - 2]) >= 1000)
+      landing_zone = true;
+    }
+  if (!landing_zone)
+    {
+    error = "the surface has no flat landing zone of at least 1000 meters";
+    return false;
+    }
+  const int16_t* s = lvl.initial;
+  if (s[0] < 0 || s[0] > W - 1 || s[1] < 0 || s[1] > H - 1 || std::abs(s[2]) > maximum_speed || std::abs(s[3]) > maximum_speed ||
+    s[4] < 0 || s[4] > maximum_fuel || std::abs(s[5]) > maximum_angle || s[6] < 0 || s[6] > maximum_thrust)
+    {
+    error = "the initial state is out of range";
+    return false;
+    }
+  return true;
+  }
+
+void set_level(const corpus_level& lvl)
+  {
+  surface_points.resize(lvl.number_of_points);
+  for (int i = 0; i < lvl.number_of_points; ++i)
+    surface_points[i] = vec2<int>(lvl.points[2 * i], lvl.points[2 * i + 1]);
+  find_landingzone(landing_zone_x0, landing_zone_x1, landing_zone_y, surface_points);
+  simdata.p = vec2<float>(lvl.initial[0], lvl.initial[1]);
+  simdata.v = vec2<float>(lvl.initial[2], lvl.initial[3]);
+  simdata.F = lvl.initial[4];
+  simdata.R = lvl.initial[5];
+  simdata.P = lvl.initial[6];
+  }
+
+void write_level(std::ostream& os, const corpus_level& lvl)
+  {
+  os << lvl.number_of_points << "\n";
+  for (int i = 0; i < lvl.number_of_points; ++i)
+    os << lvl.points[2 * i] << " " << lvl.points[2 * i + 1] << "\n";
+  os << lvl.initial[0] << " " << lvl.initial[1] << " " << lvl.initial[2] << " " << lvl.initial[3] << " "
+    << lvl.initial[4] << " " << lvl.initial[5] << " " << lvl.initial[6] << "\n";
+  }
+
+void to_level(level& out, const corpus_level& lvl)
+  {
+  out.surface.resize(lvl.number_of_points);
+  for (int i = 0; i < lvl.number_of_points; ++i)
+    out.surface[i] = vec2<int>(lvl.points[2 * i], lvl.points[2 * i + 1]);
+  out.initial.p = vec2<float>(lvl.initial[0], lvl.initial[1]);
+  out.initial.v = vec2<float>(lvl.initial[2], lvl.initial[3]);
+  out.initial.F = lvl.initial[4];
+  out.initial.R = lvl.initial[5];
+  out.initial.P = lvl.initial[6];
+  }
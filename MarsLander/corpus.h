@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include "cgalgo.h"
+
+/*
+ Packed binary level corpus (all values in the native byte order, so that levels are read in place):
+
+   header   : char magic[8] = "MLCORPUS", uint32 version, uint32 number_of_levels, uint64 index_offset,
+              uint32 byte_order = 0x01020304 as written by the machine that made the corpus, uint32 reserved
+   records  : per level int16 initial[7] = {X, Y, HS, VS, F, R, P} followed by int16 {x, y} per surface point
+   index    : uint64 offsets[number_of_levels+1], the byte offset of each record and the end of the last record
+
+ The number of surface points of a level follows from the size of its record.
+ */
+
+#define corpus_version 2
+
+struct corpus_header
+  {
+  char magic[8];
+  uint32_t version;
+  uint32_t number_of_levels;
+  uint64_t index_offset;
+  uint32_t byte_order;
+  uint32_t reserved;
+  };
+
+struct corpus_level
+  {
+  const int16_t* initial; // X, Y, HS, VS, F, R, P
+  const int16_t* points; // x0, y0, x1, y1, ...
+  int number_of_points;
+  };
+
+/*
+ Read-only memory mapped view on a corpus file. Levels are returned as pointers into the mapping.
+ */
+class corpus
+  {
+  public:
+    corpus();
+    ~corpus();
+    corpus(const corpus&) = delete;
+    void operator=(const corpus&) = delete;
+
+    bool open(const char* filename, std::string& error);
+    void close();
+
+    uint32_t size() const { return _number_of_levels; }
+
+    corpus_level operator [] (uint32_t i) const;
+
+  private:
+    const char* _data;
+    uint64_t _data_size;
+    const uint64_t* _index;
+    uint32_t _number_of_levels;
+#ifdef _WIN32
+    void* _file;
+    void* _mapping;
+#else
+    int _fd;
+#endif
+  };
+
+/*
+ Writes a corpus level by level. The index and header are written on close.
+ */
+class corpus_writer
+  {
+  public:
+    corpus_writer();
+    ~corpus_writer();
+
+    bool open(const char* filename, std::string& error);
+    void add(const level& lvl);
+    bool close(std::string& error);
+
+    uint32_t size() const { return (uint32_t)_offsets.size(); }
+
+  private:
+    std::ofstream _f;
+    std::vector<uint64_t> _offsets;
+    uint64_t _position;
+  };
+
+/*
+ Checks lvl against the limits of parse_level, including the flat landing zone of at least 1000 meters.
+ corpus::open only checks the index, so a record is checked before it is used. On failure error holds the reason.
+ */
+bool validate_level(const corpus_level& lvl, std::string& error);
+
+/*
+ Makes lvl the current level of the solver, see set_level in cgalgo.h. lvl must pass validate_level.
+ */
+void set_level(const corpus_level& lvl);
+
+/*
+ Copies lvl out of the mapping into out.
+ */
+void to_level(level& out, const corpus_level& lvl);
+
+/*
+ Writes lvl in the text format read by read_input, like write_level in generator.h.
+ */
+void write_level(std::ostream& os, const corpus_level& lvl);
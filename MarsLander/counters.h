@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdint.h>
+#include <mutex>
+#include <ostream>
+
+/*
+ Counts of the work done in the solver hot paths.
+ They are only collected if MARSLANDER_COUNTERS is defined (cmake -DMARSLANDER_COUNTERS=ON),
+ otherwise COUNT_HOT_PATH compiles to nothing and the counts stay zero.
+ */
+struct hot_path_counters
+  {
+  uint64_t physics_steps; // calls of simulate
+  uint64_t segment_tests; // surface segments tested against a step of the lander
+  uint64_t intersection_hits; // steps that crashed or landed
+  uint64_t early_exits; // evaluations that stopped before the last gene because the lander hit the surface
+  uint64_t evaluations;
+  uint64_t evaluations_skipped; // chromosomes whose score was reused instead of evaluated
+  uint64_t allocations; // buffers of the generation loop that had to grow
+  };
+
+inline void clear(hot_path_counters& c)
+  {
+  c = hot_path_counters();
+  }
+
+inline void add(hot_path_counters& sum, const hot_path_counters& c)
+  {
+  sum.physics_steps += c.physics_steps;
+  sum.segment_tests += c.segment_tests;
+  sum.intersection_hits += c.intersection_hits;
+  sum.early_exits += c.early_exits;
+  sum.evaluations += c.evaluations;
+  sum.evaluations_skipped += c.evaluations_skipped;
+  sum.allocations += c.allocations;
+  }
+
+inline std::ostream& operator << (std::ostream& os, const hot_path_counters& c)
+  {
+  return os << "physics steps " << c.physics_steps << ", segment tests " << c.segment_tests
+    << ", intersection hits " << c.intersection_hits << ", early exits " << c.early_exits
+    << ", evaluations " << c.evaluations << ", evaluations skipped " << c.evaluations_skipped
+    << ", allocations " << c.allocations;
+  }
+
+#if defined(MARSLANDER_COUNTERS)
+
+/*
+ Every thread counts in its own copy, so the hot paths only do a plain increment.
+ */
+inline thread_local hot_path_counters thread_counters = hot_path_counters();
+
+#define COUNT_HOT_PATH(name) (++thread_counters.name)
+#define COUNT_HOT_PATH_IF(name, condition) (thread_counters.name += (condition) ? 1 : 0)
+
+/*
+ Lets a chunk of parallel_for count in a clean thread_counters, and adds its counts to sum
+ when the chunk is done. The counts of the calling thread are restored afterwards, so this
+ works for the chunk that runs on the calling thread as well.
+ */
+class hot_path_chunk
+  {
+  public:
+    hot_path_chunk(hot_path_counters& sum, std::mutex& m) : _sum(sum), _mutex(m), _saved(thread_counters)
+      {
+      clear(thread_counters);
+      }
+
+    ~hot_path_chunk()
+      {
+        {
+        std::lock_guard<std::mutex> lock(_mutex);
+        add(_sum, thread_counters);
+        }
+      thread_counters = _saved;
+      }
+
+    hot_path_chunk(const hot_path_chunk&) = delete;
+    void operator=(const hot_path_chunk&) = delete;
+
+  private:
+    hot_path_counters& _sum;
+    std::mutex& _mutex;
+    hot_path_counters _saved;
+  };
+
+#else
+
+#define COUNT_HOT_PATH(name) ((void)0)
+#define COUNT_HOT_PATH_IF(name, condition) ((void)0)
+
+#endif
@@ -0,0 +1,132 @@
+#include "differential_engine.h"
+#include "counters.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+  {
+  const int genes_per_vector = chromosome_size * 2;
+
+  // uniform in [0, 1)
+  float random_unit()
+    {
+    return (float)(random_uint64() >> 40) * (1.f / 16777216.f);
+    }
+
+  int random_index(int size)
+    {
+    return (int)(random_uint64() % (uint64_t)size);
+    }
+
+  float clamp_coordinate(float x, int limit)
+    {
+    return x < -limit ? (float)-limit : x > limit ? (float)limit : x;
+    }
+
+  void decode(chromosome& c, const float* x)
+    {
+    COUNT_HOT_PATH_IF(allocations, c.capacity() < chromosome_size);
+    c.resize(chromosome_size);
+    for (int g = 0; g < chromosome_size; ++g)
+      {
+      c[g].angle = (int)std::lround(x[2 * g]);
+      c[g].thrust = (int)std::lround(x[2 * g + 1]);
+      }
+    }
+
+  // Moves the coordinates of genes that evaluate changed onto the new gene, and leaves the others alone.
+  void write_back(float* x, const chromosome& c)
+    {
+    for (int g = 0; g < chromosome_size; ++g)
+      {
+      if ((int)std::lround(x[2 * g]) != c[g].angle)
+        x[2 * g] = (float)c[g].angle;
+      if ((int)std::lround(x[2 * g + 1]) != c[g].thrust)
+        x[2 * g + 1] = (float)c[g].thrust;
+      }
+    }
+  }
+
+void init_differential(differential_evolution& de, const population& p)
+  {
+  de.vectors.resize(p.size() * genes_per_vector);
+  for (size_t i = 0; i < p.size(); ++i)
+    {
+    float* x = de.vectors.data() + i * genes_per_vector;
+    for (int g = 0; g < chromosome_size; ++g)
+      {
+      x[2 * g] = (float)p[i][g].angle;
+      x[2 * g + 1] = (float)p[i][g].thrust;
+      }
+    }
+  }
+
+void make_trials(differential_evolution& de, const std::vector<int64_t>& scores)
+  {
+  trace_scope trace("make_trials");
+  const int size = (int)scores.size();
+  COUNT_HOT_PATH_IF(allocations, de.trial_vectors.capacity() < de.vectors.size() || de.trials.capacity() < (size_t)size || de.ranking.capacity() < (size_t)size);
+  de.ranking.resize(size);
+  for (int i = 0; i < size; ++i)
+    de.ranking[i] = i;
+  const int elite = std::max(1, std::min(size, (int)std::lround(de.elite_fraction * size)));
+  std::partial_sort(de.ranking.begin(), de.ranking.begin() + elite, de.ranking.end(), [&](int left, int right)
+    {
+    if (scores[left] != scores[right])
+      return is_better_score(scores[left], scores[right]);
+    return left < right;
+    });
+  de.trial_vectors.resize(de.vectors.size());
+  de.trials.resize(size);
+  for (int i = 0; i < size; ++i)
+    {
+    const float* best_x = de.vectors.data() + (size_t)de.ranking[random_index(elite)] * genes_per_vector;
+    int a = i, b = i;
+    if (size > 2)
+      {
+      while (a == i)
+        a = random_index(size);
+      while (b == i || b == a)
+        b = random_index(size);
+      }
+    const float* x = de.vectors.data() + (size_t)i * genes_per_vector;
+    const float* xa = de.vectors.data() + (size_t)a * genes_per_vector;
+    const float* xb = de.vectors.data() + (size_t)b * genes_per_vector;
+    float* trial = de.trial_vectors.data() + (size_t)i * genes_per_vector;
+    // at least one coordinate is taken from the mutant, so that no trial is a copy of its target
+    const int forced = random_index(genes_per_vector);
+    for (int j = 0; j < genes_per_vector; ++j)
+      {
+      if (j != forced && random_unit() >= de.crossover)
+        {
+        trial[j] = x[j];
+        continue;
+        }
+      const float mutant = x[j] + de.weight * (best_x[j] - x[j]) + de.weight * (xa[j] - xb[j]);
+      trial[j] = clamp_coordinate(mutant, (j & 1) ? maximum_thrust_change : maximum_angle_rotation);
+      }
+    decode(de.trials[i], trial);
+    }
+  }
+
+void select_trials(differential_evolution& de, population& p, std::vector<int64_t>& scores, std::vector<vec2<int16_t>>* paths)
+  {
+  trace_scope trace("select_trials");
+  for (size_t i = 0; i < p.size(); ++i)
+    {
+    if (is_better_score(scores[i], de.trial_scores[i]))
+      {
+      COUNT_HOT_PATH(evaluations_skipped); // the target keeps its score
+      continue;
+      }
+    float* trial = de.trial_vectors.data() + i * genes_per_vector;
+    write_back(trial, de.trials[i]);
+    std::copy(trial, trial + genes_per_vector, de.vectors.data() + i * genes_per_vector);
+    std::swap(p[i], de.trials[i]);
+    scores[i] = de.trial_scores[i];
+    if (paths)
+      std::copy(de.trial_paths.begin() + i * chromosome_size, de.trial_paths.begin() + (i + 1) * chromosome_size, paths->begin() + i * chromosome_size);
+    }
+  }
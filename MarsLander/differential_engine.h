@@ -0,0 +1,53 @@
+#pragma once
+
+#include "cgalgo.h"
+
+#include <stdint.h>
+#include <vector>
+
+/*
+ Differential evolution over a real valued relaxation of the genes. Every chromosome of the
+ population has a vector of chromosome_size * 2 floats, the angle delta in
+ [-maximum_angle_rotation, maximum_angle_rotation] and the thrust delta in
+ [-maximum_thrust_change, maximum_thrust_change] of every step, that rounds to its genes.
+
+ Every generation each vector x gets a trial: the mutant x + weight * (best - x) + weight * (a - b),
+ with best drawn from the elite_fraction best members and a and b two other random members
+ (DE/current-to-pbest/1, which converges less prematurely than following the single best), of which every coordinate
+ is taken with probability crossover and the others from x (binomial crossover). The trials
+ are rounded to genes and scored with evaluate, and a trial replaces its target if it scores
+ at least as well. The corrections that evaluate makes to the final genes are written back
+ to the vector of the trial.
+ */
+
+struct differential_evolution
+  {
+  float weight = 0.5f; // the differential weight F
+  float crossover = 0.9f; // the crossover probability CR
+  float elite_fraction = 0.1f; // the best vector of a mutation is drawn from this top fraction of the population
+
+  std::vector<float> vectors; // chromosome_size * 2 per chromosome of the population
+  std::vector<float> trial_vectors;
+  population trials;
+  std::vector<int64_t> trial_scores;
+  std::vector<vec2<int16_t>> trial_paths; // see evaluate_population
+  std::vector<int> ranking; // scratch
+  };
+
+/*
+ Takes the genes of the evaluated population p as the starting vectors.
+ */
+void init_differential(differential_evolution& de, const population& p);
+
+/*
+ Fills de.trials with a trial per chromosome, using the random number generator of the calling thread.
+ scores are the raw scores of the current population, they rank the members for the mutation.
+ The memory of the trials is reused.
+ */
+void make_trials(differential_evolution& de, const std::vector<int64_t>& scores);
+
+/*
+ Replaces every chromosome of p that scores worse than its evaluated trial, together with its
+ score and, if paths is not null, its path (see evaluate_population).
+ */
+void select_trials(differential_evolution& de, population& p, std::vector<int64_t>& scores, std::vector<vec2<int16_t>>* paths);
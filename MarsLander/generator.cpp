@@ -0,0 +1,235 @@
+#include "generator.h"
+
+#include <sstream>
+
+/*
+ Heights are banded so that the features can never intersect each other:
+ the open terrain stays below the ledges of the overhangs, and the lander
+ starts above the top of the highest ledge.
+ */
+#define floor_min_height 50
+#define floor_max_height 1200
+#define ledge_min_height 1500
+#define ledge_max_height 2000
+#define lander_min_height 2400
+#define lander_max_height 2900
+
+namespace
+  {
+  int rand_int(RKISS& rng, int lo, int hi)
+    {
+    return lo + (int)(rng.rand64() % (uint64_t)(hi - lo + 1));
+    }
+
+  enum block_type
+    {
+    landing_zone_block,
+    overhang_block,
+    cave_block
+    };
+
+  struct block
+    {
+    block_type type;
+    int x0, x1;
+    };
+
+  // Adds a point, making sure no two consecutive points form a second flat landing zone.
+  void add_point(level& lvl, int x, int y, bool allow_flat = false)
+    {
+    if (!allow_flat && !lvl.surface.empty() && lvl.surface.back().y == y)
+      y = (y < floor_max_height) ? y + 1 : y - 1;
+    lvl.surface.emplace_back(x, y);
+    }
+
+  void add_filler_points(level& lvl, RKISS& rng, int x0, int x1, int count, bool first_gap, bool last_gap)
+    {
+    if (count <= 0)
+      return;
+    const double spacing = (double)(x1 - x0) / (double)count;
+    for (int j = 0; j < count; ++j)
+      {
+      int x = x0 + (int)((j + 0.5) * spacing);
+      const int jitter = (int)(spacing * 0.4);
+      if (jitter > 0)
+        x += rand_int(rng, -jitter, jitter);
+      if (first_gap && j == 0)
+        x = 0;
+      if (last_gap && j == count - 1)
+        x = W - 1;
+      if (!lvl.surface.empty() && x <= lvl.surface.back().x)
+        x = lvl.surface.back().x + 1;
+      add_point(lvl, x, rand_int(rng, floor_min_height, floor_max_height));
+      }
+    }
+
+  void add_overhang(level& lvl, RKISS& rng, const block& b)
+    {
+    const int w = b.x1 - b.x0;
+    const int top = rand_int(rng, ledge_min_height + 100, ledge_max_height);
+    const int bottom = top - rand_int(rng, 50, 100);
+    const bool cave = b.type == cave_block;
+    const int pocket = cave ? rand_int(rng, floor_min_height, floor_max_height / 3) : rand_int(rng, floor_min_height, floor_max_height);
+    add_point(lvl, b.x0, rand_int(rng, floor_min_height, floor_max_height));
+    add_point(lvl, b.x0 + w / 5, top);
+    add_point(lvl, b.x1, top, true);
+    add_point(lvl, b.x1, bottom);
+    // the underside of the ledge runs back to the left, a cave has a long roof
+    add_point(lvl, b.x0 + (cave ? w * 3 / 10 : w * 6 / 10), bottom, true);
+    add_point(lvl, b.x0 + (cave ? w * 4 / 10 : w * 7 / 10), pocket);
+    }
+  }
+
+generator_settings default_generator_settings()
+  {
+  generator_settings s;
+  s.number_of_points = 20;
+  s.overhangs = 0;
+  s.caves = 0;
+  s.landing_zone_width = 1000;
+  s.maximum_initial_speed = 50;
+  return s;
+  }
+
+void generate_level(level& lvl, RKISS& rng, const generator_settings& s)
+  {
+  lvl.surface.clear();
+  const int points_per_feature = 6;
+  const int landing_zone_width = std::max(1000, std::min(s.landing_zone_width, W / 2));
+  const int minimum_free_width = 1000;
+
+  // drop features that do not fit next to the landing zone
+  int overhangs = std::max(0, s.overhangs);
+  int caves = std::max(0, s.caves);
+  while (overhangs + caves > 0 && landing_zone_width + (overhangs + caves) * 500 + minimum_free_width > W - 1)
+    {
+    if (overhangs > 0)
+      --overhangs;
+    else
+      --caves;
+    }
+
+  std::vector<block> blocks;
+  block lz;
+  lz.type = landing_zone_block;
+  lz.x0 = 0;
+  lz.x1 = landing_zone_width + 1;
+  blocks.push_back(lz);
+  int free_width = W - 1 - lz.x1;
+  for (int i = 0; i < overhangs + caves; ++i)
+    {
+    block b;
+    b.type = i < overhangs ? overhang_block : cave_block;
+    b.x0 = 0;
+    b.x1 = std::min(rand_int(rng, 500, 900), free_width - minimum_free_width - (overhangs + caves - i - 1) * 500);
+    free_width -= b.x1;
+    blocks.push_back(b);
+    }
+  // shuffle the order of the blocks from left to right
+  for (int i = (int)blocks.size() - 1; i > 0; --i)
+    std::swap(blocks[i], blocks[rand_int(rng, 0, i)]);
+
+  // random gap widths in between the blocks, including before the first and after the last block
+  const int nr_of_gaps = (int)blocks.size() + 1;
+  std::vector<int> gap_width(nr_of_gaps);
+  std::vector<int> weights(nr_of_gaps);
+  int total_weight = 0;
+  for (int i = 0; i < nr_of_gaps; ++i)
+    {
+    weights[i] = rand_int(rng, 1, 100);
+    total_weight += weights[i];
+    }
+  const int minimum_gap_width = 20;
+  int remaining = free_width;
+  for (int i = 0; i < nr_of_gaps; ++i)
+    {
+    gap_width[i] = (i == nr_of_gaps - 1) ? remaining : minimum_gap_width + (int)((int64_t)(free_width - nr_of_gaps * minimum_gap_width) * weights[i] / total_weight);
+    remaining -= gap_width[i];
+    }
+
+  // distribute the filler points over the gaps proportional to their width, at most one per two meters
+  const int fixed_points = 2 + points_per_feature * (overhangs + caves);
+  const int filler_points = std::max(2, std::min(s.number_of_points - fixed_points, free_width / 2));
+  std::vector<int> gap_points(nr_of_gaps);
+  int points_left = filler_points - 2;
+  for (int i = 0; i < nr_of_gaps; ++i)
+    {
+    gap_points[i] = (i == nr_of_gaps - 1) ? points_left : (int)((int64_t)(filler_points - 2) * gap_width[i] / free_width);
+    points_left -= gap_points[i];
+    }
+  gap_points.front() += 1; // the point at x = 0
+  gap_points.back() += 1; // the point at x = W-1
+  for (int i = 0; i < nr_of_gaps; ++i)
+    gap_points[i] = std::min(gap_points[i], gap_width[i] / 2 + 1);
+
+  int x = 0;
+  int lz_index = 0;
+  for (int i = 0; i < nr_of_gaps; ++i)
+    {
+    add_filler_points(lvl, rng, x, x + gap_width[i], gap_points[i], i == 0, i == nr_of_gaps - 1);
+    x += gap_width[i];
+    if (i == nr_of_gaps - 1)
+      break;
+    block b = blocks[i];
+    const int w = b.x1;
+    b.x0 = x + 1;
+    b.x1 = x + w;
+    if (b.type == landing_zone_block)
+      {
+      const int y = rand_int(rng, floor_min_height, floor_max_height);
+      // the zone keeps its height, a previous point at the same height moves instead
+      if (!lvl.surface.empty() && lvl.surface.back().y == y)
+        {
+        const int before = lvl.surface.size() > 1 ? lvl.surface[lvl.surface.size() - 2].y : -1;
+        lvl.surface.back().y = (before == y + 1) ? y - 1 : y + 1;
+        }
+      add_point(lvl, b.x0, y, true);
+      add_point(lvl, b.x1, y, true);
+      lz_index = i;
+      }
+    else
+      add_overhang(lvl, rng, b);
+    x = b.x1;
+    blocks[i] = b;
+    }
+
+  // the lander starts above open terrain, never above a ledge
+  int X = (blocks[lz_index].x0 + blocks[lz_index].x1) / 2;
+  for (int attempt = 0; attempt < 100; ++attempt)
+    {
+    const int candidate = rand_int(rng, 0, W - 1);
+    bool above_ledge = false;
+    for (const auto& b : blocks)
+      if (b.type != landing_zone_block && candidate >= b.x0 - 100 && candidate <= b.x1 + 100)
+        above_ledge = true;
+    if (!above_ledge)
+      {
+      X = candidate;
+      break;
+      }
+    }
+  const int speed = std::max(0, std::min(s.maximum_initial_speed, 500));
+  lvl.initial.p = vec2<float>((float)X, (float)rand_int(rng, lander_min_height, lander_max_height));
+  lvl.initial.v = vec2<float>((float)rand_int(rng, -speed, speed), (float)rand_int(rng, -speed, speed / 2));
+  lvl.initial.F = rand_int(rng, 500, 2000);
+  lvl.initial.R = rand_int(rng, -6, 6) * 15;
+  lvl.initial.P = 0;
+  }
+
+bool validate_level(const level& lvl, std::string& error)
+  {
+  std::ostringstream str;
+  write_level(str, lvl);
+  level parsed;
+  return parse_level(parsed, str.str(), error);
+  }
+
+void write_level(std::ostream& os, const level& lvl)
+  {
+  os << lvl.surface.size() << "\n";
+  for (const auto& pt : lvl.surface)
+    os << pt.x << " " << pt.y << "\n";
+  os << (int)std::round(lvl.initial.p.x) << " " << (int)std::round(lvl.initial.p.y) << " "
+    << (int)std::round(lvl.initial.v.x) << " " << (int)std::round(lvl.initial.v.y) << " "
+    << lvl.initial.F << " " << lvl.initial.R << " " << lvl.initial.P << "\n";
+  }
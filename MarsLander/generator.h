@@ -0,0 +1,34 @@
+#pragma once
+
+#include "cgalgo.h"
+
+#include <ostream>
+#include <string>
+
+struct generator_settings
+  {
+  int number_of_points; // total number of surface points, raised to the minimum the features need
+  int overhangs; // ledges that stick out to the left over a pocket
+  int caves; // overhangs with a long roof over a deep pocket
+  int landing_zone_width; // at least 1000
+  int maximum_initial_speed; // bound on the absolute initial horizontal and vertical speed
+  };
+
+generator_settings default_generator_settings();
+
+/*
+ Generates a random level that parse_level accepts: the surface spans [0, W-1], has exactly one
+ flat landing zone of landing_zone_width meters, and the lander starts above all terrain.
+ The result only depends on the state of rng and on s.
+ */
+void generate_level(level& lvl, RKISS& rng, const generator_settings& s);
+
+/*
+ Checks that parse_level accepts lvl as written by write_level. On failure error holds the reason.
+ */
+bool validate_level(const level& lvl, std::string& error);
+
+/*
+ Writes lvl in the text format read by read_input.
+ */
+void write_level(std::ostream& os, const level& lvl);
@@ -1,20 +1,87 @@
 #include "logging.h"
 
-void AppLog::Clear() { Buf.clear(); LineOffsets.clear(); }
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+AppLog::AppLog(int max_lines, int max_line_length) : Lines((size_t)std::max(1, max_lines)), FirstLine(0), EndLine(0),
+MaxLineLength(max_line_length), FilteredFirst(0), ScrollToBottom(false)
+  {
+  }
+
+void AppLog::Clear()
+  {
+  FirstLine = EndLine = 0;
+  Partial.clear();
+  Filtered.clear();
+  FilteredFirst = 0;
+  }
+
+void AppLog::AddLine(const char* line, const char* line_end)
+  {
+  std::string& dst = Lines[EndLine % Lines.size()];
+  dst.assign(line, std::min<size_t>(line_end - line, (size_t)MaxLineLength));
+  if (Filter.IsActive() && Filter.PassFilter(dst.c_str(), dst.c_str() + dst.size()))
+    Filtered.push_back(EndLine);
+  ++EndLine;
+  if (EndLine - FirstLine > Lines.size())
+    ++FirstLine;
+  // forget filtered lines that were overwritten, compacting once the dead prefix gets large
+  while (FilteredFirst < Filtered.size() && Filtered[FilteredFirst] < FirstLine)
+    ++FilteredFirst;
+  if (FilteredFirst > Lines.size())
+    {
+    Filtered.erase(Filtered.begin(), Filtered.begin() + FilteredFirst);
+    FilteredFirst = 0;
+    }
+  }
 
 void AppLog::AddLog(const char* fmt, ...) IM_FMTARGS(2)
   {
-  int old_size = Buf.size();
+  ImGuiTextBuffer buf;
   va_list args;
   va_start(args, fmt);
-  Buf.appendfv(fmt, args);
+  buf.appendfv(fmt, args);
   va_end(args);
-  for (int new_size = Buf.size(); old_size < new_size; old_size++)
-    if (Buf[old_size] == '\n')
-      LineOffsets.push_back(old_size);
+  const char* line = buf.begin();
+  const char* end = buf.end();
+  for (const char* p = line; p != end; ++p)
+    {
+    if (*p != '\n')
+      continue;
+    if (Partial.empty())
+      AddLine(line, p);
+    else
+      {
+      Partial.append(line, p);
+      AddLine(Partial.data(), Partial.data() + Partial.size());
+      Partial.clear();
+      }
+    line = p + 1;
+    }
+  if (Partial.size() < (size_t)MaxLineLength)
+    Partial.append(line, std::min<size_t>(end - line, MaxLineLength - Partial.size()));
   ScrollToBottom = true;
   }
 
+void AppLog::Refilter()
+  {
+  Filtered.clear();
+  FilteredFirst = 0;
+  if (!Filter.IsActive())
+    return;
+  for (uint64_t i = FirstLine; i < EndLine; ++i)
+    {
+    const std::string& l = Line(i);
+    if (Filter.PassFilter(l.c_str(), l.c_str() + l.size()))
+      Filtered.push_back(i);
+    }
+  }
+
 void AppLog::Draw(const char* title, bool* p_open)
   {
   //ImGui::SetNextWindowSize(ImVec2(800, 300), ImGuiCond_Appearing);
@@ -28,27 +95,39 @@ void AppLog::Draw(const char* title, bool* p_open)
   ImGui::SameLine();
   bool copy = ImGui::Button("Copy");
   ImGui::SameLine();
-  Filter.Draw("Filter", -100.0f);
+  if (Filter.Draw("Filter", -100.0f))
+    Refilter();
   ImGui::Separator();
   ImGui::BeginChild("scrolling", ImVec2(0, 0), false, ImGuiWindowFlags_HorizontalScrollbar);
   if (copy) ImGui::LogToClipboard();
 
-  if (Filter.IsActive())
+  const bool filtered = Filter.IsActive();
+  const int count = filtered ? (int)(Filtered.size() - FilteredFirst) : (int)(EndLine - FirstLine);
+  ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0, 0));
+  if (copy)
     {
-    const char* buf_begin = Buf.begin();
-    const char* line = buf_begin;
-    for (int line_no = 0; line != NULL; line_no++)
+    // copying needs every line, not only the visible ones
+    for (int i = 0; i < count; ++i)
       {
-      const char* line_end = (line_no < LineOffsets.Size) ? buf_begin + LineOffsets[line_no] : NULL;
-      if (Filter.PassFilter(line, line_end))
-        ImGui::TextUnformatted(line, line_end);
-      line = line_end && line_end[1] ? line_end + 1 : NULL;
+      const std::string& l = Line(filtered ? Filtered[FilteredFirst + i] : FirstLine + i);
+      ImGui::TextUnformatted(l.c_str(), l.c_str() + l.size());
       }
     }
   else
     {
-    ImGui::TextUnformatted(Buf.begin());
+    ImGuiListClipper clipper;
+    clipper.Begin(count);
+    while (clipper.Step())
+      {
+      for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
+        {
+        const std::string& l = Line(filtered ? Filtered[FilteredFirst + i] : FirstLine + i);
+        ImGui::TextUnformatted(l.c_str(), l.c_str() + l.size());
+        }
+      }
+    clipper.End();
     }
+  ImGui::PopStyleVar();
 
   if (ScrollToBottom)
     ImGui::SetScrollHereY(1.0f);
@@ -57,42 +136,225 @@ void AppLog::Draw(const char* title, bool* p_open)
   ImGui::End();
   }
 
-Logging& Logging::GetInstance()
+namespace
+  {
+#define log_ring_size 512
+
+  struct log_ring
+    {
+    log_record records[log_ring_size];
+    std::atomic<uint64_t> head; // written by the owning thread only
+    std::atomic<uint64_t> tail; // written by drain only
+    std::atomic<bool> in_use;
+    uint32_t thread;
+
+    log_ring() : head(0), tail(0), in_use(false), thread(0) {}
+    };
+
+  struct log_registry
+    {
+    std::mutex mutex; // guards rings, file and next_thread, never taken while logging to an existing ring
+    std::vector<std::unique_ptr<log_ring>> rings;
+    std::ofstream file;
+    std::atomic<uint64_t> dropped;
+    uint32_t next_thread;
+    std::chrono::steady_clock::time_point start;
+
+    log_registry() : dropped(0), next_thread(0), start(std::chrono::steady_clock::now()) {}
+    };
+
+  log_registry& registry()
+    {
+    static log_registry r;
+    return r;
+    }
+
+  struct thread_ring
+    {
+    log_ring* ring = nullptr;
+
+    ~thread_ring()
+      {
+      if (ring)
+        ring->in_use = false;
+      }
+    };
+
+  thread_local thread_ring current_ring;
+
+  log_ring* get_ring()
+    {
+    if (!current_ring.ring)
+      {
+      log_registry& r = registry();
+      std::lock_guard<std::mutex> lock(r.mutex);
+      for (auto& ring : r.rings)
+        {
+        if (!ring->in_use)
+          {
+          current_ring.ring = ring.get();
+          break;
+          }
+        }
+      if (!current_ring.ring)
+        {
+        r.rings.emplace_back(new log_ring());
+        current_ring.ring = r.rings.back().get();
+        }
+      current_ring.ring->in_use = true;
+      current_ring.ring->thread = r.next_thread++;
+      }
+    return current_ring.ring;
+    }
+
+  void write_record(std::ostream& os, const log_record& r)
+    {
+    os << "[" << log_level_name(r.level) << "] ";
+    os.write(r.text, r.length);
+    os << "\n";
+    }
+  }
+
+const char* log_level_name(log_level level)
   {
-  static Logging instance; // Guaranteed to be destroyed.
-                        // Instantiated on first use.
-  return instance;
+  static const char* names[] = { "Debug", "Info", "Warning", "Error" };
+  return names[level];
+  }
+
+log_line::log_line(log_level level) : _enabled(Logging::enabled(level)), _level(level), _length(0)
+  {
+  }
+
+log_line::~log_line()
+  {
+  if (!_enabled)
+    return;
+  // one record per line, the trailing newline is implied
+  while (_length > 0 && _text[_length - 1] == '\n')
+    --_length;
+  Logging::_push(_level, _text, _length);
+  }
+
+void log_line::_append(const char* text, size_t length)
+  {
+  const size_t n = std::min(length, (size_t)(log_message_size - _length));
+  memcpy(_text + _length, text, n);
+  _length += (uint32_t)n;
+  }
+
+log_line& log_line::operator << (const char* text)
+  {
+  if (_enabled)
+    _append(text, strlen(text));
+  return *this;
   }
 
-Logging::Logging()
+log_line& log_line::operator << (const std::string& text)
   {
+  if (_enabled)
+    _append(text.data(), text.size());
+  return *this;
   }
 
-Logging& Logging::operator << (const char* text)
+log_line& log_line::operator << (char c)
   {
-  _os << text;
+  if (_enabled)
+    _append(&c, 1);
   return *this;
   }
 
-std::string Logging::pop_messages()
+#define LOG_LINE_NUMBER(type, format) \
+log_line& log_line::operator << (type v) \
+  { \
+  if (_enabled) \
+    { \
+    char buf[32]; \
+    const int n = snprintf(buf, sizeof(buf), format, v); \
+    if (n > 0) \
+      _append(buf, std::min((size_t)n, sizeof(buf) - 1)); \
+    } \
+  return *this; \
+  }
+
+LOG_LINE_NUMBER(int, "%d")
+LOG_LINE_NUMBER(unsigned int, "%u")
+LOG_LINE_NUMBER(long, "%ld")
+LOG_LINE_NUMBER(unsigned long, "%lu")
+LOG_LINE_NUMBER(long long, "%lld")
+LOG_LINE_NUMBER(unsigned long long, "%llu")
+LOG_LINE_NUMBER(float, "%g")
+LOG_LINE_NUMBER(double, "%g")
+
+#undef LOG_LINE_NUMBER
+
+std::atomic<int> Logging::_minimum_level(log_info);
+
+void Logging::_push(log_level level, const char* text, uint32_t length)
   {
-  std::string mess = _os.str();
-  _os.clear();
-  _os.str("");
-  return mess;
+  log_ring* ring = get_ring();
+  const uint64_t head = ring->head.load(std::memory_order_relaxed);
+  if (head - ring->tail.load(std::memory_order_acquire) >= log_ring_size)
+    {
+    ++registry().dropped;
+    return;
+    }
+  log_record& r = ring->records[head % log_ring_size];
+  r.time_us = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - registry().start).count();
+  r.thread = ring->thread;
+  r.level = level;
+  r.length = length;
+  memcpy(r.text, text, length);
+  ring->head.store(head + 1, std::memory_order_release);
   }
 
-Logging& Logging::Info()
+void Logging::drain(std::vector<log_record>& out)
   {
-  return GetInstance() << "[Info] ";
+  out.clear();
+  log_registry& reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  for (auto& ring : reg.rings)
+    {
+    const uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+    const uint64_t head = ring->head.load(std::memory_order_acquire);
+    for (uint64_t i = tail; i < head; ++i)
+      out.push_back(ring->records[i % log_ring_size]);
+    ring->tail.store(head, std::memory_order_release);
+    }
+  std::stable_sort(out.begin(), out.end(), [](const log_record& a, const log_record& b) { return a.time_us < b.time_us; });
+  if (reg.file.is_open())
+    {
+    for (const auto& r : out)
+      {
+      reg.file << r.time_us << " " << r.thread << " ";
+      write_record(reg.file, r);
+      }
+    reg.file.flush();
+    }
+  }
+
+bool Logging::set_file(const char* filename, std::string& error)
+  {
+  log_registry& reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  if (reg.file.is_open())
+    reg.file.close();
+  reg.file.open(filename, std::ios::app);
+  if (!reg.file.is_open())
+    {
+    error = std::string("cannot open ") + filename;
+    return false;
+    }
+  return true;
   }
 
-Logging& Logging::Warning()
+uint64_t Logging::dropped()
   {
-  return GetInstance() << "[Warning] ";
+  return registry().dropped;
   }
 
-Logging& Logging::Error()
+std::string Logging::format(const log_record& r)
   {
-  return GetInstance() << "[Error] ";
-  }
\ No newline at end of file
+  std::ostringstream os;
+  write_record(os, r);
+  return os.str();
+  }
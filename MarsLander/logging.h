@@ -3,47 +3,147 @@
 #include "imgui.h"
 
 #include <sstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <atomic>
 
+/*
+ Log window that keeps at most MaxLines lines of at most MaxLineLength characters, so its memory
+ is bounded. The oldest lines are dropped first. Only the visible lines are laid out, and the
+ filter is only applied to new lines unless the filter text changes.
+ */
 class AppLog
   {
   public:
+    AppLog(int max_lines = 10000, int max_line_length = 512);
+
     void Clear();
     void AddLog(const char* fmt, ...) IM_FMTARGS(2);
     void Draw(const char* title, bool* p_open = NULL);
 
   private:
-    ImGuiTextBuffer     Buf;
+    void AddLine(const char* line, const char* line_end);
+    const std::string& Line(uint64_t line_no) const { return Lines[line_no % Lines.size()]; }
+    void Refilter();
+
+  private:
+    std::vector<std::string> Lines;     // ring buffer, line number i is at Lines[i % MaxLines]
+    uint64_t            FirstLine;      // number of the oldest line that is kept
+    uint64_t            EndLine;        // number of the next line
+    std::string         Partial;        // text after the last newline
+    int                 MaxLineLength;
     ImGuiTextFilter     Filter;
-    ImVector<int>       LineOffsets;        // Index to lines offset
+    std::vector<uint64_t> Filtered;     // numbers of the kept lines that pass the filter, ascending
+    size_t              FilteredFirst;  // entries of Filtered before this index are dropped lines
     bool                ScrollToBottom;
   };
 
 
 
-class Logging
+enum log_level
+  {
+  log_debug,
+  log_info,
+  log_warning,
+  log_error
+  };
+
+const char* log_level_name(log_level level);
+
+#define log_message_size 240
+
+struct log_record
+  {
+  uint64_t time_us; // since the first use of the logger
+  uint32_t thread; // small number, in order of the first message of each thread
+  log_level level;
+  uint32_t length;
+  char text[log_message_size]; // not null terminated, longer messages are truncated
+  };
+
+/*
+ Collects one message, which is queued when the line goes out of scope.
+ Every operator << is a single branch when the level is disabled.
+ */
+class log_line
   {
   public:
-    static Logging& GetInstance();
-    static Logging& Info();
-    static Logging& Warning();
-    static Logging& Error();
-    Logging(Logging const&) = delete;
-    void operator=(Logging const&) = delete;
+    log_line(log_level level);
+    ~log_line();
+    log_line(const log_line&) = delete;
+    void operator=(const log_line&) = delete;
 
-    Logging& operator << (const char* text);
+    log_line& operator << (const char* text);
+    log_line& operator << (const std::string& text);
+    log_line& operator << (char c);
+    log_line& operator << (int v);
+    log_line& operator << (unsigned int v);
+    log_line& operator << (long v);
+    log_line& operator << (unsigned long v);
+    log_line& operator << (long long v);
+    log_line& operator << (unsigned long long v);
+    log_line& operator << (float v);
+    log_line& operator << (double v);
 
     template <class T>
-    Logging& operator << (const T& t)
+    log_line& operator << (const T& t)
       {
-      _os << t;
+      if (_enabled)
+        {
+        std::ostringstream os;
+        os << t;
+        _append(os.str().c_str(), os.str().size());
+        }
       return *this;
       }
 
-    std::string pop_messages();
+  private:
+    void _append(const char* text, size_t length);
+
+  private:
+    bool _enabled;
+    log_level _level;
+    uint32_t _length;
+    char _text[log_message_size];
+  };
+
+/*
+ Logger that can be used from any thread.
+
+ Every thread that logs owns a lock-free single producer, single consumer ring of records,
+ so logging never blocks and never allocates. If the ring of a thread is full because nobody
+ drains, new records of that thread are dropped and counted. Rings of threads that have exited
+ are reused by new threads.
+
+ drain collects the queued records of all threads in time order, and also writes them to the
+ log file if one is set. It must only be called from one thread at a time (the ui thread).
+ */
+class Logging
+  {
+  public:
+    static log_line Debug() { return log_line(log_debug); }
+    static log_line Info() { return log_line(log_info); }
+    static log_line Warning() { return log_line(log_warning); }
+    static log_line Error() { return log_line(log_error); }
+
+    static bool enabled(log_level level) { return level >= _minimum_level.load(std::memory_order_relaxed); }
+    static void set_level(log_level minimum_level) { _minimum_level = minimum_level; }
+
+    static bool set_file(const char* filename, std::string& error);
+
+    static void drain(std::vector<log_record>& out);
+
+    // Number of records that were dropped because a ring was full.
+    static uint64_t dropped();
+
+    // Formats r as "[Level] text\n".
+    static std::string format(const log_record& r);
 
   private:
-    Logging();
+    friend class log_line;
+    static void _push(log_level level, const char* text, uint32_t length);
 
   private:
-    std::ostringstream _os;
-  };
\ No newline at end of file
+    static std::atomic<int> _minimum_level;
+  };
@@ -0,0 +1,208 @@
+#include "macro_engine.h"
+#include "counters.h"
+#include "parallel.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+namespace
+  {
+  vec2<int16_t> to_path_point(int X, int Y)
+    {
+    return vec2<int16_t>((int16_t)std::max(-32768, std::min(32767, X)), (int16_t)std::max(-32768, std::min(32767, Y)));
+    }
+
+  // The state after t steps of constant angle and thrust from sd, which already holds them.
+  void advance(simulation_data& out, const simulation_data& sd, const vec2<float>& a, int t)
+    {
+    const float ft = (float)t;
+    out.p = sd.p + sd.v * ft + a * (0.5f * ft * ft);
+    out.v = sd.v + a * ft;
+    out.F = sd.F - sd.P * t;
+    out.R = sd.R;
+    out.P = sd.P;
+    }
+
+  // Widens [lo, hi] with the extreme of p + v t + a t^2 / 2 for t in (0, steps), if there is one.
+  void widen(float& lo, float& hi, float p, float v, float a, int steps)
+    {
+    if (a == 0.f)
+      return;
+    const float t = -v / a;
+    if (t <= 0.f || t >= (float)steps)
+      return;
+    const float extreme = p + v * t + 0.5f * a * t * t;
+    lo = std::min(lo, extreme);
+    hi = std::max(hi, extreme);
+    }
+
+  // The target of a gene within the range of the angle and thrust.
+  gene clamp_target(const gene& target)
+    {
+    return gene{ std::max(-maximum_angle, std::min(maximum_angle, target.angle)), std::max(0, std::min(maximum_thrust, target.thrust)) };
+    }
+
+  // Moves R and P towards target as far as one step allows, like evaluate and simulate clamp a gene.
+  void step_towards(int& R, int& P, const gene& target)
+    {
+    R = std::max(R - maximum_angle_rotation, std::min(R + maximum_angle_rotation, target.angle));
+    P = std::max(P - maximum_thrust_change, std::min(P + maximum_thrust_change, target.thrust));
+    }
+  }
+
+void expand_macro(chromosome& c, const chromosome& macro, int hold)
+  {
+  COUNT_HOT_PATH_IF(allocations, c.capacity() < chromosome_size);
+  c.resize(chromosome_size);
+  int R = simdata.R;
+  int P = simdata.P;
+  for (int i = 0; i < chromosome_size; ++i)
+    {
+    int next_R = R, next_P = P;
+    step_towards(next_R, next_P, clamp_target(macro[i / hold]));
+    c[i] = gene{ next_R - R, next_P - P };
+    R = next_R;
+    P = next_P;
+    }
+  }
+
+gene generate_random_target()
+  {
+  gene g;
+  g.angle = (int)(random_uint64() % (2 * maximum_angle + 1)) - maximum_angle;
+  g.thrust = (int)(random_uint64() % (maximum_thrust + 1));
+  return g;
+  }
+
+population generate_random_macro_population(int size, int hold)
+  {
+  population p(size);
+  for (chromosome& c : p)
+    {
+    c.reserve(macro_genes(hold));
+    for (int g = 0; g < macro_genes(hold); ++g)
+      c.push_back(generate_random_target());
+    }
+  return p;
+  }
+
+int64_t evaluate_macro(vec2<int16_t>* path, const chromosome& macro, int hold, chromosome& c)
+  {
+  COUNT_HOT_PATH(evaluations);
+  expand_macro(c, macro, hold);
+  simulation_data sd = simdata;
+  simulation_data sd_prev = sd;
+  simulation_data sd_prev2 = sd_prev;
+  int PX = (int)std::round(sd.p[0]); // previous X
+  int PY = (int)std::round(sd.p[1]); // previous Y
+  int step = 0;
+  bool crashed = false;
+  while (step < chromosome_size && !crashed)
+    {
+    COUNT_HOT_PATH(physics_steps);
+    const gene target = clamp_target(macro[step / hold]);
+    const int hold_end = std::min((step / hold + 1) * hold, chromosome_size);
+    step_towards(sd.R, sd.P, target);
+    // a step that still turns or throttles is a segment of its own, the rest of the hold is one segment
+    const int steps = sd.R == target.angle && sd.P == target.thrust ? hold_end - step : 1;
+    const float ang = (float)sd.R * (float)pi / 180.f;
+    const vec2<float> a = vec2<float>(0, -3.711f) + vec2<float>(std::cos(pi / 2.f + ang), std::sin(pi / 2.f + ang)) * (float)sd.P;
+    simulation_data end;
+    advance(end, sd, a, steps);
+
+    // the chords between the rounded positions of the segment lie in the box of the arc, widened by the rounding
+    float x0 = std::min(sd.p.x, end.p.x), x1 = std::max(sd.p.x, end.p.x);
+    float y0 = std::min(sd.p.y, end.p.y), y1 = std::max(sd.p.y, end.p.y);
+    widen(x0, x1, sd.p.x, sd.v.x, a.x, steps);
+    widen(y0, y1, sd.p.y, sd.v.y, a.y, steps);
+    x0 -= 1.f, y0 -= 1.f, x1 += 1.f, y1 += 1.f;
+    thread_local std::vector<int> candidates;
+    candidates.clear();
+    for (int i = 1; i < (int)surface_points.size(); ++i)
+      {
+      const vec2<int>& p = surface_points[i - 1];
+      const vec2<int>& q = surface_points[i];
+      if (std::max(p.x, q.x) < x0 || std::min(p.x, q.x) > x1 || std::max(p.y, q.y) < y0 || std::min(p.y, q.y) > y1)
+        continue;
+      candidates.push_back(i);
+      }
+
+    if (candidates.empty() && !path)
+      {
+      // the whole segment at once
+      if (steps >= 2)
+        advance(sd_prev2, sd, a, steps - 1);
+      else
+        sd_prev2 = sd_prev;
+      sd = end;
+      sd_prev = end;
+      PX = (int)std::round(sd.p[0]);
+      PY = (int)std::round(sd.p[1]);
+      step += steps;
+      continue;
+      }
+
+    const simulation_data start = sd;
+    for (int t = 1; t <= steps; ++t, ++step)
+      {
+      advance(sd, start, a, t);
+      const int X = (int)std::round(sd.p[0]);
+      const int Y = (int)std::round(sd.p[1]);
+      if (path)
+        path[step] = to_path_point(X, Y);
+      const vec2<int> p2(X, Y), q2(PX, PY);
+      for (int i : candidates)
+        {
+        COUNT_HOT_PATH(segment_tests);
+        if (intersects(surface_points[i - 1], surface_points[i], p2, q2))
+          {
+          COUNT_HOT_PATH(intersection_hits);
+          crashed = true;
+          break;
+          }
+        }
+      if (crashed)
+        {
+        COUNT_HOT_PATH_IF(early_exits, step + 1 < chromosome_size);
+        if (path)
+          std::fill(path + step + 1, path + chromosome_size, to_path_point(X, Y));
+        break;
+        }
+      sd_prev2 = sd_prev;
+      sd_prev = sd;
+      PX = X;
+      PY = Y;
+      }
+    }
+  return score_flight(sd, sd_prev, sd_prev2, step, c);
+  }
+
+void evaluate_macro_population(std::vector<int64_t>& scores, const population& macro, int hold, population& p, std::vector<vec2<int16_t>>* paths)
+  {
+  COUNT_HOT_PATH_IF(allocations, scores.capacity() < macro.size() || p.capacity() < macro.size());
+  scores.resize(macro.size());
+  p.resize(macro.size());
+  if (paths)
+    {
+    COUNT_HOT_PATH_IF(allocations, paths->capacity() < macro.size() * chromosome_size);
+    paths->resize(macro.size() * chromosome_size);
+    }
+#if defined(MARSLANDER_COUNTERS)
+  hot_path_counters sum = hot_path_counters();
+  std::mutex sum_mutex;
+#endif
+  parallel_for((int)macro.size(), number_of_threads, [&](int first, int last)
+    {
+    trace_scope trace("evaluation chunk");
+#if defined(MARSLANDER_COUNTERS)
+    hot_path_chunk chunk(sum, sum_mutex);
+#endif
+    for (int i = first; i < last; ++i)
+      scores[i] = evaluate_macro(paths ? paths->data() + (size_t)i * chromosome_size : nullptr, macro[i], hold, p[i]);
+    });
+#if defined(MARSLANDER_COUNTERS)
+  add(thread_counters, sum);
+#endif
+  }
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "cgalgo.h"
+
+#include <stdint.h>
+#include <vector>
+
+/*
+ Macro step encoding for the genetic algorithm. A macro chromosome has macro_genes(hold) genes,
+ and gene g holds an angle and thrust target from step g * hold on: every step of its hold the
+ angle and thrust move towards the target as far as a regular gene can, and stay there once it
+ is reached. It flies exactly like the regular chromosome of expand_macro, which has these
+ changes as its genes.
+
+ Once the target is reached the angle and thrust, so the acceleration, are constant, and the
+ lander follows p(t) = p + v t + a t^2 / 2. evaluate_macro advances the rest of the hold at once
+ with this closed form, and tests collision against the bounding box of the swept parabola first:
+ only surface segments that overlap it are tested step by step, with the same segments between
+ rounded positions as crashed_or_landed. The search has hold times fewer dimensions, and most
+ holds cost one box test per surface segment instead of one segment test per step.
+ */
+
+struct macro_search
+  {
+  int hold = 25; // steps per gene
+  population current, next; // macro chromosomes, the population of the solver holds their expansions
+  };
+
+inline int macro_genes(int hold)
+  {
+  return (chromosome_size + hold - 1) / hold;
+  }
+
+/*
+ Makes the regular chromosome c that flies like macro from the current level. The memory of c is reused.
+ */
+void expand_macro(chromosome& c, const chromosome& macro, int hold);
+
+/*
+ A target with a uniform angle in [-maximum_angle, maximum_angle] and thrust in [0, maximum_thrust].
+ */
+gene generate_random_target();
+
+population generate_random_macro_population(int size, int hold);
+
+/*
+ Scores macro like evaluate scores expand_macro(macro), which is written to c with the corrections
+ of its final genes. If path is not null, it receives the chromosome_size positions as with evaluate.
+ Positions come from the closed form, so the score can differ from evaluate in the last bits, and rarely a rounded position by one.
+ */
+int64_t evaluate_macro(vec2<int16_t>* path, const chromosome& macro, int hold, chromosome& c);
+
+/*
+ Evaluates every macro chromosome in parallel like evaluate_population, p receives their expansions.
+ */
+void evaluate_macro_population(std::vector<int64_t>& scores, const population& macro, int hold, population& p, std::vector<vec2<int16_t>>* paths = nullptr);
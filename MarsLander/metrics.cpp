@@ -0,0 +1,170 @@
+#include "metrics.h"
+#include "solver.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+void compute_metrics(generation_metrics& m, const solver& s)
+  {
+  m.run = s.run;
+  m.generation = s.generation;
+  m.selection_ms = s.selection_ms;
+  m.breeding_ms = s.breeding_ms;
+  m.evaluation_ms = s.evaluation_ms;
+  m.counters = s.counters;
+
+  // the normalized score is cumulative, so its smallest value marks the worst chromosome
+  const int worst = (int)(std::min_element(s.current_population_normalized_score.begin(), s.current_population_normalized_score.end()) - s.current_population_normalized_score.begin());
+  int64_t sum = 0;
+  for (int64_t v : s.scores)
+    sum += v;
+  m.best_score = best_score(s);
+  m.worst_score = s.scores[worst];
+  m.mean_score = s.scores.empty() ? 0 : sum / (int64_t)s.scores.size();
+
+  const population& p = s.current_population;
+  double total_deviation = 0.0;
+  for (int g = 0; g < chromosome_size; ++g)
+    {
+    double sum_angle = 0.0, sum_angle_sqr = 0.0, sum_thrust = 0.0, sum_thrust_sqr = 0.0;
+    for (const chromosome& c : p)
+      {
+      sum_angle += c[g].angle;
+      sum_angle_sqr += (double)c[g].angle * c[g].angle;
+      sum_thrust += c[g].thrust;
+      sum_thrust_sqr += (double)c[g].thrust * c[g].thrust;
+      }
+    const double n = (double)p.size();
+    const double var_angle = sum_angle_sqr / n - (sum_angle / n) * (sum_angle / n);
+    const double var_thrust = sum_thrust_sqr / n - (sum_thrust / n) * (sum_thrust / n);
+    total_deviation += std::sqrt(std::max(0.0, var_angle + var_thrust));
+    }
+  m.diversity = p.empty() ? 0.0 : total_deviation / chromosome_size;
+
+  simulation_data sd, prev_sd;
+  m.valid_landing = best_is_a_valid_landing(s, sd, prev_sd);
+  m.fuel = sd.F;
+  }
+
+metrics_writer::metrics_writer() : _format(metrics_csv), _quit(false)
+  {
+  }
+
+metrics_writer::~metrics_writer()
+  {
+  close();
+  }
+
+bool metrics_writer::open(const char* filename, std::string& error)
+  {
+  close();
+  const std::string name(filename);
+  auto ends_with = [&](const char* suffix)
+    {
+    const size_t n = strlen(suffix);
+    return name.size() >= n && name.compare(name.size() - n, n, suffix) == 0;
+    };
+  _format = (ends_with(".jsonl") || ends_with(".json")) ? metrics_json_lines : metrics_csv;
+  _f.open(filename, std::ios::trunc);
+  if (!_f.is_open())
+    {
+    error = std::string("cannot create ") + filename;
+    return false;
+    }
+  if (_format == metrics_csv)
+    {
+    _f << "run,generation,best_score,mean_score,worst_score,diversity,valid_landing,fuel,selection_ms,breeding_ms,evaluation_ms";
+#if defined(MARSLANDER_COUNTERS)
+    _f << ",physics_steps,segment_tests,intersection_hits,early_exits,evaluations,evaluations_skipped,allocations";
+#endif
+    _f << "\n";
+    }
+  _quit = false;
+  _thread = std::thread(&metrics_writer::_run, this);
+  return true;
+  }
+
+void metrics_writer::close()
+  {
+  if (_thread.joinable())
+    {
+      {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _quit = true;
+      }
+    _wake_up.notify_one();
+    _thread.join();
+    }
+  if (_f.is_open())
+    _f.close();
+  }
+
+void metrics_writer::push(const generation_metrics& m)
+  {
+    {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _queue.push_back(m);
+    }
+  _wake_up.notify_one();
+  }
+
+void metrics_writer::_run()
+  {
+  std::vector<generation_metrics> batch;
+  std::chrono::steady_clock::time_point last_flush = std::chrono::steady_clock::now();
+  for (;;)
+    {
+    bool quit;
+      {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _wake_up.wait(lock, [this]() { return _quit || !_queue.empty(); });
+      std::swap(batch, _queue);
+      quit = _quit;
+      }
+    for (const auto& m : batch)
+      _write(m);
+    batch.clear();
+    if (quit)
+      break;
+    // keep the file buffered, but let a dashboard that tails it see progress every second
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (now - last_flush >= std::chrono::seconds(1))
+      {
+      _f.flush();
+      last_flush = now;
+      }
+    }
+  }
+
+void metrics_writer::_write(const generation_metrics& m)
+  {
+  if (_format == metrics_csv)
+    {
+    _f << m.run << "," << m.generation << "," << m.best_score << "," << m.mean_score << "," << m.worst_score << ","
+      << m.diversity << "," << (m.valid_landing ? 1 : 0) << "," << m.fuel << ","
+      << m.selection_ms << "," << m.breeding_ms << "," << m.evaluation_ms;
+#if defined(MARSLANDER_COUNTERS)
+    const hot_path_counters& c = m.counters;
+    _f << "," << c.physics_steps << "," << c.segment_tests << "," << c.intersection_hits << "," << c.early_exits
+      << "," << c.evaluations << "," << c.evaluations_skipped << "," << c.allocations;
+#endif
+    _f << "\n";
+    }
+  else
+    {
+    _f << "{\"run\":" << m.run << ",\"generation\":" << m.generation << ",\"best_score\":" << m.best_score
+      << ",\"mean_score\":" << m.mean_score << ",\"worst_score\":" << m.worst_score << ",\"diversity\":" << m.diversity
+      << ",\"valid_landing\":" << (m.valid_landing ? "true" : "false") << ",\"fuel\":" << m.fuel
+      << ",\"selection_ms\":" << m.selection_ms << ",\"breeding_ms\":" << m.breeding_ms << ",\"evaluation_ms\":" << m.evaluation_ms;
+#if defined(MARSLANDER_COUNTERS)
+    const hot_path_counters& c = m.counters;
+    _f << ",\"physics_steps\":" << c.physics_steps << ",\"segment_tests\":" << c.segment_tests
+      << ",\"intersection_hits\":" << c.intersection_hits << ",\"early_exits\":" << c.early_exits
+      << ",\"evaluations\":" << c.evaluations << ",\"evaluations_skipped\":" << c.evaluations_skipped
+      << ",\"allocations\":" << c.allocations;
+#endif
+    _f << "}\n";
+    }
+  }
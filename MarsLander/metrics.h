@@ -0,0 +1,75 @@
+#pragma once
+
+#include "counters.h"
+
+#include <stdint.h>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct solver;
+
+struct generation_metrics
+  {
+  int run; // see solver::run
+  int generation;
+  int64_t best_score, mean_score, worst_score; // raw scores, see evaluate
+  double diversity; // mean over the genes of the standard deviation of angle and thrust in the population
+  bool valid_landing; // of the best chromosome
+  int fuel; // left after the flight of the best chromosome
+  double selection_ms, breeding_ms, evaluation_ms;
+  hot_path_counters counters; // only written with MARSLANDER_COUNTERS
+  };
+
+/*
+ Fills m for the current generation of s.
+ */
+void compute_metrics(generation_metrics& m, const solver& s);
+
+enum metrics_format
+  {
+  metrics_csv,
+  metrics_json_lines
+  };
+
+/*
+ Writes one record per generation to a CSV or JSON lines file.
+ push only appends to a queue, the file is written by a background thread, so the solver never
+ waits for the disk.
+ */
+class metrics_writer
+  {
+  public:
+    metrics_writer();
+    ~metrics_writer();
+    metrics_writer(const metrics_writer&) = delete;
+    void operator=(const metrics_writer&) = delete;
+
+    /*
+     Files ending in .jsonl or .json get JSON lines, all others CSV with a header line.
+     */
+    bool open(const char* filename, std::string& error);
+
+    // Writes the remaining records and closes the file.
+    void close();
+
+    bool is_open() const { return _thread.joinable(); }
+
+    void push(const generation_metrics& m);
+
+  private:
+    void _run();
+    void _write(const generation_metrics& m);
+
+  private:
+    std::ofstream _f;
+    metrics_format _format;
+    std::thread _thread;
+    std::mutex _mutex;
+    std::condition_variable _wake_up;
+    std::vector<generation_metrics> _queue;
+    bool _quit;
+  };
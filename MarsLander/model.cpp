@@ -2,6 +2,7 @@
 #include "model.h"
 #include "logging.h"
 #include "cgalgo.h"
+#include "trace.h"
 
 #include <glew/GL/glew.h>
 #include "jtk/jtk/opengl.h"
@@ -11,7 +12,8 @@
 #include <numeric>
 
 
-model::model() : _vao(nullptr), _vbo_array(nullptr)
+model::model() : number_of_terrain_points(0), landing_zone_first(0), _vao(nullptr), _vbo_array(nullptr), number_of_paths(0), best_path(0), path_vertex_capacity(0),
+_path_vao(nullptr), _path_vbo_array(nullptr), _path_score_vbo_array(nullptr)
   {
 
   }
@@ -22,6 +24,36 @@ model::~model()
   }
 
 void model::delete_render_objects()
+  {
+  delete_terrain_render_objects();
+  delete_path_render_objects();
+  }
+
+void model::delete_path_render_objects()
+  {
+  if (_path_vao)
+    {
+    _path_vao->release();
+    delete _path_vao;
+    _path_vao = nullptr;
+    }
+  if (_path_vbo_array)
+    {
+    _path_vbo_array->release();
+    delete _path_vbo_array;
+    _path_vbo_array = nullptr;
+    }
+  if (_path_score_vbo_array)
+    {
+    _path_score_vbo_array->release();
+    delete _path_score_vbo_array;
+    _path_score_vbo_array = nullptr;
+    }
+  path_vertex_capacity = 0;
+  number_of_paths = 0;
+  }
+
+void model::delete_terrain_render_objects()
   {
   if (_vao)
     {
@@ -35,30 +67,18 @@ void model::delete_render_objects()
     delete _vbo_array;
     _vbo_array = nullptr;
     }
-  for (size_t i = 0; i < _path_vao.size(); ++i) {
-    if (_path_vao[i]) {
-      _path_vao[i]->release();
-      delete _path_vao[i];
-      _path_vao[i] = nullptr;
-      }
-    if (_path_vbo_array[i]) {
-      _path_vbo_array[i]->release();
-      delete _path_vbo_array[i];
-      _path_vbo_array[i] = nullptr;
-      }
-    }
   }
 
 void init_model(model&, const std::string& s) {
-  std::stringstream ss;
-  ss << s;
-  std::stringstream logss;
-  read_input(ss, logss);
-  Logging::Info() << logss.str();
+  std::string error;
+  if (!read_input(s, error))
+    Logging::Error() << error << "\n";
+  else
+    Logging::Info() << "Loaded level with " << surface_points.size() << " surface points\n";
   }
 
-void make_random_population(model& m) {
-  m.current_population = generate_random_population();
+void make_random_population(model& m, int size) {
+  m.current_population = generate_random_population(size);
   }
 
 void make_next_generation(model& m) {
@@ -69,14 +89,21 @@ void make_next_generation(model& m) {
 void fill_terrain_data(model& m)
   {
   using namespace jtk;
+  m.delete_terrain_render_objects();
   m.number_of_terrain_points = (int)surface_points.size();
-  std::vector<GLfloat> vertices;
-  vertices.reserve(m.number_of_terrain_points * 2);
-  uint64_t n = m.number_of_terrain_points;
-  for (uint64_t i = 0; i < n; ++i)
+  std::vector<vec2<int16_t>> vertices;
+  vertices.reserve(m.number_of_terrain_points);
+  for (const auto& pt : surface_points)
+    vertices.emplace_back((int16_t)pt.x, (int16_t)pt.y);
+  m.landing_zone_first = 0;
+  for (int i = 1; i < m.number_of_terrain_points; ++i)
     {
-    vertices.push_back(surface_points[i].x / (float)W * 2.f - 1.f);
-    vertices.push_back(surface_points[i].y / (float)H * 2.f - 1.f);
+    if (surface_points[i].y == landing_zone_y && surface_points[i - 1].y == landing_zone_y &&
+      std::min(surface_points[i].x, surface_points[i - 1].x) == landing_zone_x0)
+      {
+      m.landing_zone_first = i - 1;
+      break;
+      }
     }
 
   m._vao = new vertex_array_object();
@@ -91,8 +118,10 @@ void fill_terrain_data(model& m)
   m._vbo_array->bind();
   gl_check_error("_vbo_array->bind()");
   m._vbo_array->set_usage_pattern(GL_STATIC_DRAW);
-  m._vbo_array->allocate(vertices.data(), (int)(sizeof(GLfloat) * vertices.size()));
+  m._vbo_array->allocate(vertices.data(), (int)(sizeof(vec2<int16_t>) * vertices.size()));
   gl_check_error("_vbo_array->allocate()");
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 2, GL_SHORT, GL_FALSE, sizeof(vec2<int16_t>), 0); // world x y
 
   m._vao->release();
   gl_check_error("m._vao->release()");
@@ -102,58 +131,70 @@ void fill_terrain_data(model& m)
 
 void fill_renderer_with_simulation(model& m) {
   using namespace jtk;
-  m._path_vao.clear();
-  m._path_vbo_array.clear();
-  for (int i = 0; i < m.current_population.size(); ++i) {
-    std::vector<vec2<float>> path;
-    evaluate(path, m.current_population[i]);
-    std::vector<GLfloat> vertices;
-    vertices.reserve(path.size() * 2);
-    for (uint64_t j = 0; j < path.size(); ++j)
-      {
-      vertices.push_back(path[j].x / (float)W * 2.f - 1.f);
-      vertices.push_back(path[j].y / (float)H * 2.f - 1.f);
-      }
-    m._path_vao.push_back(new vertex_array_object());
-    m._path_vao.back()->create();
-    gl_check_error(" _path_vao.back()->create()");
-    m._path_vao.back()->bind();
-    gl_check_error(" _path_vao.back()->bind()");
-
-    m._path_vbo_array.push_back(new buffer_object(GL_ARRAY_BUFFER));
-    m._path_vbo_array.back()->create();
-    gl_check_error("_path_vbo_array.back()->create()");
-    m._path_vbo_array.back()->bind();
-    gl_check_error("_path_vbo_array.back()->bind()");
-    m._path_vbo_array.back()->set_usage_pattern(GL_STATIC_DRAW);
-    m._path_vbo_array.back()->allocate(vertices.data(), (int)(sizeof(GLfloat) * vertices.size()));
-    gl_check_error("_path_vbo_array.back()->allocate()");
-
-    m._path_vao.back()->release();
-    gl_check_error("m._path_vao.back()->release()");
-    m._path_vbo_array.back()->release();
-    gl_check_error("m._path_vbo_array.back()->release()");
+  trace_scope trace("fill_renderer_with_simulation");
+  m.number_of_paths = (int)m.current_population.size();
+  const int number_of_vertices = m.number_of_paths * chromosome_size;
+  m.path_scores.resize(number_of_vertices);
+  m.path_first.resize(m.number_of_paths);
+  m.path_count.resize(m.number_of_paths);
+  m.best_path = get_best_index(m.current_population_normalized_score);
+  for (int i = 0; i < m.number_of_paths; ++i) {
+    const uint8_t score = (uint8_t)(std::max(0.0, std::min(1.0, m.current_population_normalized_score[i])) * 255.0);
+    std::fill(m.path_scores.begin() + i * chromosome_size, m.path_scores.begin() + (i + 1) * chromosome_size, score);
+    m.path_first[i] = i * chromosome_size;
+    m.path_count[i] = chromosome_size;
     }
+
+  trace_scope trace_upload("gl upload");
+  if (!m._path_vao || m.path_vertex_capacity < number_of_vertices)
+    {
+    m.delete_path_render_objects();
+    m._path_vao = new vertex_array_object();
+    m._path_vao->create();
+    gl_check_error(" _path_vao->create()");
+    m._path_vao->bind();
+    gl_check_error(" _path_vao->bind()");
+
+    m._path_vbo_array = new buffer_object(GL_ARRAY_BUFFER);
+    m._path_vbo_array->create();
+    m._path_vbo_array->bind();
+    m._path_vbo_array->set_usage_pattern(GL_DYNAMIC_DRAW);
+    m._path_vbo_array->allocate(m.current_population_paths.data(), (int)(sizeof(vec2<int16_t>) * number_of_vertices));
+    gl_check_error("_path_vbo_array->allocate()");
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_SHORT, GL_FALSE, sizeof(vec2<int16_t>), 0); // world x y
+
+    m._path_score_vbo_array = new buffer_object(GL_ARRAY_BUFFER);
+    m._path_score_vbo_array->create();
+    m._path_score_vbo_array->bind();
+    m._path_score_vbo_array->set_usage_pattern(GL_DYNAMIC_DRAW);
+    m._path_score_vbo_array->allocate(m.path_scores.data(), (int)m.path_scores.size());
+    gl_check_error("_path_score_vbo_array->allocate()");
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 1, GL_UNSIGNED_BYTE, GL_TRUE, 1, 0); // normalized score
+
+    m.path_vertex_capacity = number_of_vertices;
+    m._path_vao->release();
+    m._path_score_vbo_array->release();
+    return;
+    }
+
+  // Update in place. Orphaning the old storage first lets the driver hand out fresh memory
+  // instead of waiting for draws that still read the previous trajectories.
+  m._path_vbo_array->bind();
+  glBufferData(GL_ARRAY_BUFFER, sizeof(vec2<int16_t>) * m.path_vertex_capacity, nullptr, GL_DYNAMIC_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vec2<int16_t>) * number_of_vertices, m.current_population_paths.data());
+  m._path_score_vbo_array->bind();
+  glBufferData(GL_ARRAY_BUFFER, m.path_vertex_capacity, nullptr, GL_DYNAMIC_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, m.path_scores.size(), m.path_scores.data());
+  m._path_score_vbo_array->release();
   }
 
 void simulate_population(model& m) {
-  std::vector<int64_t> scores;
-  scores.reserve(m.current_population.size());
-  for (int i = 0; i < m.current_population.size(); ++i) {
-    std::vector<vec2<float>> path;
-    scores.push_back(evaluate(path, m.current_population[i]));
-    }
-  normalize_scores_roulette_wheel(m.current_population_normalized_score, scores);
+  evaluate_population(m.current_population_scores, m.current_population, &m.current_population_paths);
+  normalize_scores_roulette_wheel(m.current_population_normalized_score, m.current_population_scores);
   }
 
 void get_best_run_results(simulation_data& sd, simulation_data& prev_sd, const model& m) {
-  int besti = 0;
-  double score = 0.0;
-  for (int i = 0; i < m.current_population_normalized_score.size(); ++i) {
-    if (m.current_population_normalized_score[i] > score) {
-      score = m.current_population_normalized_score[i];
-      besti = i;
-      }
-    }
-  run_chromosome(sd, prev_sd, m.current_population[besti]);
+  run_chromosome(sd, prev_sd, m.current_population[get_best_index(m.current_population_normalized_score)]);
   }
@@ -19,23 +19,40 @@ struct model
   ~model();
 
   void delete_render_objects();
+  void delete_terrain_render_objects();
+  void delete_path_render_objects();
   
   int number_of_terrain_points;
+  int landing_zone_first; // index of the first terrain point of the landing zone
   
   population current_population, next_population;
+  std::vector<int64_t> current_population_scores; // raw scores, as set by simulate_population
   std::vector<double> current_population_normalized_score;
+  std::vector<vec2<int16_t>> current_population_paths; // chromosome_size points per chromosome, recorded while scoring
 
   jtk::vertex_array_object* _vao;
   jtk::buffer_object *_vbo_array;
-  
-  std::vector<jtk::vertex_array_object*> _path_vao;
-  std::vector<jtk::buffer_object*> _path_vbo_array;
+
+  // All trajectories live in one vertex buffer, path i starts at vertex i*chromosome_size.
+  // The buffers only grow, and are otherwise updated in place.
+  // Vertices are int16 world coordinates straight from current_population_paths, the
+  // vertex shader maps them to clip space (see view::_world_to_clip).
+  // Each vertex also carries the normalized score of its path, so that the whole
+  // population is drawn with a single glMultiDrawArrays call.
+  int number_of_paths;
+  int best_path;
+  int path_vertex_capacity;
+  std::vector<uint8_t> path_scores;
+  std::vector<int> path_first, path_count;
+  jtk::vertex_array_object* _path_vao;
+  jtk::buffer_object* _path_vbo_array;
+  jtk::buffer_object* _path_score_vbo_array;
   };
 
 
 void init_model(model& m, const std::string& s);
 
-void make_random_population(model& m);
+void make_random_population(model& m, int size = population_size);
 
 void fill_renderer_with_simulation(model& m);
 
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ Worker threads that stay alive between calls of parallel_for, so that a generation wakes
+ sleeping workers instead of starting and joining new threads. Workers are started when a
+ call first needs them and live until the end of the program.
+ One thread at a time runs tasks on the pool, other threads are turned away by run.
+ */
+class worker_pool
+  {
+  public:
+    static worker_pool& instance()
+      {
+      static worker_pool pool;
+      return pool;
+      }
+
+    ~worker_pool()
+      {
+        {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _quit = true;
+        }
+      _wake_up.notify_all();
+      for (auto& t : _workers)
+        t.join();
+      }
+
+    /*
+     Calls task(t) for every t in [1, nr_of_tasks) on the workers and task(0) on the calling
+     thread, and returns when all of them are done. Returns false without calling task if
+     another thread, or a task of this pool, is already running tasks on the pool.
+     */
+    bool run(int nr_of_tasks, const std::function<void(int)>& task)
+      {
+      if (_busy.exchange(true))
+        return false;
+      std::unique_lock<std::mutex> lock(_mutex);
+      while ((int)_workers.size() < nr_of_tasks - 1)
+        _workers.emplace_back(&worker_pool::_work, this, (int)_workers.size() + 1, _round);
+      _task = &task;
+      _tasks = nr_of_tasks;
+      _pending = nr_of_tasks - 1;
+      ++_round;
+      lock.unlock();
+      _wake_up.notify_all();
+      task(0);
+      lock.lock();
+      _done.wait(lock, [&] { return _pending == 0; });
+      _task = nullptr;
+      lock.unlock();
+      _busy = false;
+      return true;
+      }
+
+  private:
+    worker_pool() = default;
+
+    void _work(int index, uint64_t round)
+      {
+      std::unique_lock<std::mutex> lock(_mutex);
+      for (;;)
+        {
+        _wake_up.wait(lock, [&] { return _quit || _round != round; });
+        if (_quit)
+          return;
+        round = _round;
+        if (index >= _tasks)
+          continue;
+        const std::function<void(int)>& task = *_task;
+        lock.unlock();
+        task(index);
+        lock.lock();
+        if (--_pending == 0)
+          _done.notify_one();
+        }
+      }
+
+  private:
+    std::atomic<bool> _busy{ false }; // set while a thread is in run
+    std::mutex _mutex; // guards everything below
+    std::condition_variable _wake_up, _done;
+    std::vector<std::thread> _workers;
+    const std::function<void(int)>* _task = nullptr;
+    int _tasks = 0;
+    int _pending = 0;
+    uint64_t _round = 0;
+    bool _quit = false;
+  };
+
+/*
+ Splits [0, size) in nr_of_threads contiguous chunks and calls fun(first, last) for each chunk
+ on its own thread of the worker_pool. The first chunk runs on the calling thread. Chunks are
+ kept at least minimum_chunk_size long so that small workloads are not split for nothing.
+ If the pool is in use, e.g. by the parallel jobs of the convergence bench, the chunks run on
+ threads of their own instead.
+ */
+template <class TFunctor>
+void parallel_for(int size, int nr_of_threads, TFunctor fun, int minimum_chunk_size = 16)
+  {
+  nr_of_threads = std::max(1, std::min(nr_of_threads, size / std::max(1, minimum_chunk_size)));
+  if (nr_of_threads == 1)
+    {
+    fun(0, size);
+    return;
+    }
+  const int chunk = (size + nr_of_threads - 1) / nr_of_threads;
+  const std::function<void(int)> task = [&](int t)
+    {
+    const int first = t * chunk;
+    const int last = std::min(size, first + chunk);
+    if (first < last)
+      fun(first, last);
+    };
+  if (worker_pool::instance().run(nr_of_threads, task))
+    return;
+  std::vector<std::thread> threads;
+  threads.reserve(nr_of_threads - 1);
+  for (int t = 1; t < nr_of_threads; ++t)
+    threads.emplace_back(task, t);
+  task(0);
+  for (auto& t : threads)
+    t.join();
+  }
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum profile_phase
+  {
+  phase_selection, // normalizing the scores into the roulette wheel
+  phase_breeding, // make_next_generation
+  phase_evaluation, // evaluate_population, including the path capture
+  phase_snapshot, // copying a generation for the ui
+  phase_upload, // filling the vertex buffers
+  phase_draw,
+  phase_ui,
+  phase_swap,
+  number_of_profile_phases
+  };
+
+inline const char* profile_phase_name(profile_phase phase)
+  {
+  static const char* names[number_of_profile_phases] = { "selection", "breeding", "evaluation", "snapshot", "upload", "draw", "ui", "swap" };
+  return names[phase];
+  }
+
+#define profiler_history 256
+
+/*
+ Keeps the last profiler_history durations in milliseconds of every phase.
+ add may be called from any thread.
+ */
+class profiler
+  {
+  public:
+    profiler() : _next{}, _count{}, _samples{}
+      {
+      }
+
+    void add(profile_phase phase, double ms)
+      {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _samples[phase][_next[phase]] = (float)ms;
+      _next[phase] = (_next[phase] + 1) % profiler_history;
+      _count[phase] = std::min(_count[phase] + 1, profiler_history);
+      }
+
+    // Copies the samples of phase into out, oldest first.
+    void samples(std::vector<float>& out, profile_phase phase) const
+      {
+      std::lock_guard<std::mutex> lock(_mutex);
+      out.resize(_count[phase]);
+      const int first = (_next[phase] + profiler_history - _count[phase]) % profiler_history;
+      for (int i = 0; i < _count[phase]; ++i)
+        out[i] = _samples[phase][(first + i) % profiler_history];
+      }
+
+    void clear()
+      {
+      std::lock_guard<std::mutex> lock(_mutex);
+      std::fill(_next, _next + number_of_profile_phases, 0);
+      std::fill(_count, _count + number_of_profile_phases, 0);
+      }
+
+    /*
+     Writes one line per phase: name, mean, maximum, followed by the samples, oldest first.
+     */
+    bool dump(const char* filename, std::string& error) const
+      {
+      std::ofstream f(filename);
+      if (!f.is_open())
+        {
+        error = std::string("cannot create ") + filename;
+        return false;
+        }
+      f << "phase,mean_ms,max_ms,samples_ms\n";
+      std::vector<float> s;
+      for (int p = 0; p < number_of_profile_phases; ++p)
+        {
+        samples(s, (profile_phase)p);
+        double sum = 0.0;
+        float maximum = 0.f;
+        for (float v : s)
+          {
+          sum += v;
+          maximum = std::max(maximum, v);
+          }
+        f << profile_phase_name((profile_phase)p) << "," << (s.empty() ? 0.0 : sum / s.size()) << "," << maximum;
+        for (float v : s)
+          f << "," << v;
+        f << "\n";
+        }
+      return true;
+      }
+
+  private:
+    mutable std::mutex _mutex;
+    int _next[number_of_profile_phases];
+    int _count[number_of_profile_phases];
+    float _samples[number_of_profile_phases][profiler_history];
+  };
+
+/*
+ Adds the lifetime of the timer to phase. A null profiler makes the timer a no-op.
+ */
+class scoped_timer
+  {
+  public:
+    scoped_timer(profiler* p, profile_phase phase) : _p(p), _phase(phase)
+      {
+      if (_p)
+        _start = std::chrono::steady_clock::now();
+      }
+
+    ~scoped_timer()
+      {
+      if (_p)
+        _p->add(_phase, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _start).count());
+      }
+
+    scoped_timer(const scoped_timer&) = delete;
+    void operator=(const scoped_timer&) = delete;
+
+  private:
+    profiler* _p;
+    profile_phase _phase;
+    std::chrono::steady_clock::time_point _start;
+  };
@@ -0,0 +1,242 @@
+#include "publisher.h"
+#include "solver.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+  {
+  const char publication_magic[8] = { 'M', 'L', 'P', 'U', 'B', 'L', 'S', 'H' };
+
+#ifdef _WIN32
+  std::string segment_name(const char* name)
+    {
+    return std::string("Local\\") + name;
+    }
+#else
+  std::string segment_name(const char* name)
+    {
+    return std::string("/") + name;
+    }
+#endif
+  }
+
+trajectory_publisher::trajectory_publisher() : _segment(nullptr), _interval(std::chrono::milliseconds(50))
+#ifdef _WIN32
+, _mapping(nullptr)
+#else
+, _fd(-1)
+#endif
+  {
+  }
+
+trajectory_publisher::~trajectory_publisher()
+  {
+  close();
+  }
+
+bool trajectory_publisher::open(const char* name, std::string& error)
+  {
+  close();
+  _name = segment_name(name);
+  void* data = nullptr;
+#ifdef _WIN32
+  _mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(publication), _name.c_str());
+  if (_mapping)
+    data = MapViewOfFile(_mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(publication));
+#else
+  _fd = shm_open(_name.c_str(), O_CREAT | O_RDWR, 0644);
+  if (_fd >= 0 && ftruncate(_fd, sizeof(publication)) == 0)
+    {
+    data = mmap(nullptr, sizeof(publication), PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (data == MAP_FAILED)
+      data = nullptr;
+    }
+#endif
+  if (!data)
+    {
+    error = std::string("cannot create the shared memory segment ") + _name;
+    close();
+    return false;
+    }
+  _segment = new (data) publication(); // zero initialized
+  _segment->version = publication_version;
+  _segment->size = sizeof(publication);
+  _segment->sequence.store(0, std::memory_order_relaxed);
+  _segment->active.store(1, std::memory_order_relaxed);
+  // readers check the magic last, so they never see a half initialized header
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(_segment->magic, publication_magic, sizeof(publication_magic));
+  _last = std::chrono::steady_clock::time_point();
+  return true;
+  }
+
+void trajectory_publisher::close()
+  {
+  if (_segment)
+    _segment->active.store(0, std::memory_order_release);
+#ifdef _WIN32
+  if (_segment)
+    UnmapViewOfFile(_segment);
+  if (_mapping)
+    CloseHandle(_mapping);
+  _mapping = nullptr;
+#else
+  if (_segment)
+    munmap(_segment, sizeof(publication));
+  if (_fd >= 0)
+    {
+    ::close(_fd);
+    shm_unlink(_name.c_str());
+    }
+  _fd = -1;
+#endif
+  _segment = nullptr;
+  }
+
+void trajectory_publisher::publish(const solver& s, const simulation_data& sd, const simulation_data& prev_sd, bool valid_landing, bool force)
+  {
+  if (!_segment)
+    return;
+  const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  if (!valid_landing && !force && now - _last < _interval)
+    return;
+  _last = now;
+
+  const int best = get_best_index(s.current_population_normalized_score);
+  const chromosome& c = s.current_population[best];
+  const int number_of_genes = std::min((int)c.size(), chromosome_size);
+  const vec2<int16_t>* path;
+  if (s.record_paths && s.paths.size() >= (size_t)(best + 1) * chromosome_size)
+    path = s.paths.data() + (size_t)best * chromosome_size;
+  else
+    {
+    // evaluate corrects the final genes, so it gets a copy
+    _best = c;
+    _path.resize(chromosome_size);
+    evaluate(_path.data(), _best);
+    path = _path.data();
+    }
+
+  published_trajectory& t = _segment->trajectory;
+  const uint64_t sequence = _segment->sequence.load(std::memory_order_relaxed);
+  _segment->sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  t.run = s.run;
+  t.generation = s.generation;
+  t.score = s.scores[best];
+  t.valid_landing = valid_landing ? 1 : 0;
+  t.number_of_genes = number_of_genes;
+  t.last = sd;
+  t.previous = prev_sd;
+  memcpy(t.genes, c.data(), number_of_genes * sizeof(gene));
+  memcpy(t.path, path, chromosome_size * sizeof(vec2<int16_t>));
+  _segment->sequence.store(sequence + 2, std::memory_order_release);
+  }
+
+trajectory_reader::trajectory_reader() : _segment(nullptr)
+#ifdef _WIN32
+, _mapping(nullptr)
+#else
+, _fd(-1)
+#endif
+  {
+  }
+
+trajectory_reader::~trajectory_reader()
+  {
+  close();
+  }
+
+bool trajectory_reader::open(const char* name, std::string& error)
+  {
+  close();
+  const std::string full_name = segment_name(name);
+  const void* data = nullptr;
+#ifdef _WIN32
+  _mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, full_name.c_str());
+  if (_mapping)
+    data = MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, sizeof(publication));
+#else
+  _fd = shm_open(full_name.c_str(), O_RDONLY, 0);
+  struct stat st;
+  if (_fd >= 0 && fstat(_fd, &st) == 0 && (size_t)st.st_size >= sizeof(publication))
+    {
+    data = mmap(nullptr, sizeof(publication), PROT_READ, MAP_SHARED, _fd, 0);
+    if (data == MAP_FAILED)
+      data = nullptr;
+    }
+#endif
+  if (!data)
+    {
+    error = std::string("cannot open the shared memory segment ") + full_name;
+    close();
+    return false;
+    }
+  _segment = (const publication*)data;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (memcmp(_segment->magic, publication_magic, sizeof(publication_magic)) != 0 || _segment->version != publication_version || _segment->size != sizeof(publication))
+    {
+    error = full_name + " is not a publication of version " + std::to_string(publication_version) + " of this build";
+    close();
+    return false;
+    }
+  return true;
+  }
+
+void trajectory_reader::close()
+  {
+#ifdef _WIN32
+  if (_segment)
+    UnmapViewOfFile(_segment);
+  if (_mapping)
+    CloseHandle(_mapping);
+  _mapping = nullptr;
+#else
+  if (_segment)
+    munmap((void*)_segment, sizeof(publication));
+  if (_fd >= 0)
+    ::close(_fd);
+  _fd = -1;
+#endif
+  _segment = nullptr;
+  }
+
+uint64_t trajectory_reader::begin() const
+  {
+  for (;;)
+    {
+    const uint64_t sequence = _segment->sequence.load(std::memory_order_acquire);
+    if ((sequence & 1) == 0)
+      return sequence;
+    std::this_thread::yield();
+    }
+  }
+
+bool trajectory_reader::retry(uint64_t sequence) const
+  {
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return _segment->sequence.load(std::memory_order_relaxed) != sequence;
+  }
+
+uint64_t trajectory_reader::read(published_trajectory& out) const
+  {
+  uint64_t sequence;
+  do
+    {
+    sequence = begin();
+    memcpy(&out, &_segment->trajectory, sizeof(published_trajectory));
+    } while (retry(sequence));
+  return sequence;
+  }
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "cgalgo.h"
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+struct solver;
+
+#define publication_version 1
+
+/*
+ The best chromosome of the last published generation, its final state as computed by
+ get_best_run_results, and the trajectory that was scored (see evaluate).
+ */
+struct published_trajectory
+  {
+  int32_t run;
+  int32_t generation;
+  int64_t score; // raw score of the best chromosome
+  int32_t valid_landing;
+  int32_t number_of_genes;
+  simulation_data last, previous; // the state after the final step and the one before
+  gene genes[chromosome_size];
+  vec2<int16_t> path[chromosome_size];
+  };
+
+/*
+ The layout of the shared memory segment. The solver is the only writer and protects the
+ trajectory with a sequence lock: sequence is odd while the trajectory is written.
+ A reader may use the trajectory in place, without copying, as long as sequence was even
+ before and is unchanged after, see trajectory_reader::begin and trajectory_reader::retry.
+ */
+struct publication
+  {
+  char magic[8];
+  uint32_t version;
+  uint32_t size; // sizeof(publication)
+  std::atomic<uint32_t> active; // cleared when the publisher closes, the trajectory then stays as it was
+  std::atomic<uint64_t> sequence;
+  published_trajectory trajectory;
+  };
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the sequence must be lock free to be shared between processes");
+
+/*
+ Publishes the best trajectory of a running solver in a named shared memory segment.
+ The segment is created by open and removed by close. Publishing never blocks, and
+ generations within interval_ms of the previous publication are skipped, so the
+ solver pays one clock read per generation.
+ */
+class trajectory_publisher
+  {
+  public:
+    trajectory_publisher();
+    ~trajectory_publisher();
+    trajectory_publisher(const trajectory_publisher&) = delete;
+    void operator=(const trajectory_publisher&) = delete;
+
+    bool open(const char* name, std::string& error);
+    void close();
+
+    bool is_open() const { return _segment != nullptr; }
+
+    void set_interval(double interval_ms) { _interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(interval_ms)); }
+
+    /*
+     Publishes the best chromosome of s with its final states sd and prev_sd, as returned
+     by best_is_a_valid_landing. Publishing is throttled to the interval, except for a valid
+     landing or with force, e.g. for the last generation of a run.
+     */
+    void publish(const solver& s, const simulation_data& sd, const simulation_data& prev_sd, bool valid_landing, bool force = false);
+
+  private:
+    publication* _segment;
+    std::string _name;
+    std::chrono::steady_clock::duration _interval;
+    std::chrono::steady_clock::time_point _last;
+    chromosome _best; // the copy of the best chromosome that is evaluated for its path
+    std::vector<vec2<int16_t>> _path;
+#ifdef _WIN32
+    void* _mapping;
+#else
+    int _fd;
+#endif
+  };
+
+/*
+ Maps the segment of a trajectory_publisher read only.
+ */
+class trajectory_reader
+  {
+  public:
+    trajectory_reader();
+    ~trajectory_reader();
+    trajectory_reader(const trajectory_reader&) = delete;
+    void operator=(const trajectory_reader&) = delete;
+
+    bool open(const char* name, std::string& error);
+    void close();
+
+    const publication* segment() const { return _segment; }
+
+    // Waits until the publisher is not writing, and returns the sequence to pass to retry.
+    uint64_t begin() const;
+
+    // Returns true if the trajectory was changed since begin returned sequence, so what was read must be discarded.
+    bool retry(uint64_t sequence) const;
+
+    // Copies a consistent trajectory to out and returns its sequence.
+    uint64_t read(published_trajectory& out) const;
+
+  private:
+    const publication* _segment;
+#ifdef _WIN32
+    void* _mapping;
+#else
+    int _fd;
+#endif
+  };
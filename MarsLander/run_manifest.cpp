@@ -0,0 +1,173 @@
+#include "run_manifest.h"
+#include "solver.h"
+
+#include <json.hpp>
+
+#include <chrono>
+#include <fstream>
+
+uint64_t hash_level(const std::string& text)
+  {
+  uint64_t h = 14695981039346656037ull;
+  for (unsigned char ch : text)
+    {
+    h ^= ch;
+    h *= 1099511628211ull;
+    }
+  return h;
+  }
+
+void begin_manifest(run_manifest& m, const std::string& level_text, const solver& s, int seed, int population, int max_generations)
+  {
+  m.seed = seed;
+  m.population = population;
+  m.max_generations = max_generations;
+  m.engine = s.engine;
+  m.beam_width = s.beam.width;
+  m.hold = s.macro.hold;
+  m.elitarism_factor = elitarism_factor;
+  m.mutation_chance = mutation_chance;
+  m.build = build_configuration();
+  m.level = level_text;
+  m.level_hash = hash_level(m.level);
+  m.best_scores.clear();
+  m.landed = false;
+  m.milliseconds = 0.0;
+  }
+
+void write_manifest(std::ostream& os, const run_manifest& m)
+  {
+  nlohmann::json j;
+  j["version"] = run_manifest_version;
+  j["seed"] = m.seed;
+  j["population"] = m.population;
+  j["max_generations"] = m.max_generations;
+  j["engine"] = engine_name(m.engine);
+  j["beam_width"] = m.beam_width;
+  j["hold"] = m.hold;
+  j["elitarism_factor"] = m.elitarism_factor;
+  j["mutation_chance"] = m.mutation_chance;
+  j["build"] = m.build;
+  j["level_hash"] = m.level_hash;
+  j["level"] = m.level;
+  j["best_scores"] = m.best_scores;
+  j["landed"] = m.landed;
+  j["milliseconds"] = m.milliseconds;
+  os << j.dump() << "\n";
+  }
+
+bool read_manifests(std::vector<run_manifest>& out, const char* filename, std::string& error)
+  {
+  std::ifstream f(filename);
+  if (!f.is_open())
+    {
+    error = std::string("cannot open ") + filename;
+    return false;
+    }
+  out.clear();
+  std::string line;
+  int line_number = 0;
+  while (std::getline(f, line))
+    {
+    ++line_number;
+    if (line.empty())
+      continue;
+    try
+      {
+      const nlohmann::json j = nlohmann::json::parse(line);
+      if (j.at("version").get<int>() != run_manifest_version)
+        {
+        error = std::string(filename) + ", line " + std::to_string(line_number) + ": unsupported manifest version";
+        return false;
+        }
+      run_manifest m;
+      m.seed = j.at("seed").get<int>();
+      m.population = j.at("population").get<int>();
+      m.max_generations = j.at("max_generations").get<int>();
+      m.engine = engine_genetic;
+      if (!parse_engine(m.engine, j.value("engine", std::string("genetic")).c_str()))
+        {
+        error = std::string(filename) + ", line " + std::to_string(line_number) + ": unknown engine";
+        return false;
+        }
+      m.beam_width = j.value("beam_width", beam_search().width);
+      m.hold = j.value("hold", macro_search().hold);
+      if (m.beam_width < 1 || m.hold < 1)
+        {
+        error = std::string(filename) + ", line " + std::to_string(line_number) + ": beam_width and hold must be at least 1";
+        return false;
+        }
+      if (m.population < 1 || m.max_generations < 0)
+        {
+        error = std::string(filename) + ", line " + std::to_string(line_number) + ": population must be at least 1 and max_generations at least 0";
+        return false;
+        }
+      m.elitarism_factor = j.at("elitarism_factor").get<double>();
+      m.mutation_chance = j.at("mutation_chance").get<double>();
+      m.build = j.at("build").get<std::string>();
+      m.level_hash = j.at("level_hash").get<uint64_t>();
+      m.level = j.at("level").get<std::string>();
+      m.best_scores = j.at("best_scores").get<std::vector<int64_t>>();
+      m.landed = j.at("landed").get<bool>();
+      m.milliseconds = j.at("milliseconds").get<double>();
+      out.push_back(m);
+      }
+    catch (const nlohmann::json::exception& e)
+      {
+      error = std::string(filename) + ", line " + std::to_string(line_number) + ": " + e.what();
+      return false;
+      }
+    }
+  return true;
+  }
+
+bool replay(replay_result& result, const run_manifest& m, std::string& error)
+  {
+  if (hash_level(m.level) != m.level_hash)
+    {
+    error = "the level does not match its hash";
+    return false;
+    }
+  level lvl;
+  if (!parse_level(lvl, m.level, error))
+    return false;
+  if (m.best_scores.empty())
+    {
+    error = "the manifest has no generations";
+    return false;
+    }
+  set_level(lvl);
+  elitarism_factor = m.elitarism_factor;
+  mutation_chance = m.mutation_chance;
+  seed_random(m.seed);
+
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::vector<int64_t> best_scores;
+  best_scores.reserve(m.best_scores.size());
+  solver s;
+  s.engine = m.engine;
+  s.beam.width = m.beam_width;
+  s.macro.hold = m.hold;
+  s.best_scores = &best_scores;
+  init_solver(s, m.population);
+  while (best_scores.size() < m.best_scores.size())
+    run_generation(s);
+  simulation_data sd, prev_sd;
+  result.landed = best_is_a_valid_landing(s, sd, prev_sd);
+  result.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+  result.first_mismatch = -1;
+  result.expected_score = result.actual_score = 0;
+  for (size_t g = 0; g < best_scores.size(); ++g)
+    {
+    if (best_scores[g] != m.best_scores[g])
+      {
+      result.first_mismatch = (int)g;
+      result.expected_score = m.best_scores[g];
+      result.actual_score = best_scores[g];
+      break;
+      }
+    }
+  result.identical = result.first_mismatch < 0 && result.landed == m.landed;
+  return true;
+  }
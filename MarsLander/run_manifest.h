@@ -0,0 +1,73 @@
+#pragma once
+
+#include "cgalgo.h"
+#include "solver.h"
+
+#include <stdint.h>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#define run_manifest_version 1
+
+/*
+ Everything a run of the solver depends on, together with the raw score of its best chromosome
+ in every generation, so that the run can be replayed and verified on another build or machine.
+ The run is fully determined by these fields: evaluation is parallel but does not draw random
+ numbers, and selection and breeding use the generator of the solving thread (see seed_random).
+ */
+struct run_manifest
+  {
+  int seed; // see seed_random
+  int population;
+  int max_generations;
+  solver_engine engine; // written by name, manifests without it are genetic
+  int beam_width; // beam_search::width, only used by engine_beam
+  int hold; // macro_search::hold, only used by engine_macro
+  double elitarism_factor;
+  double mutation_chance;
+  std::string build; // see build_configuration
+  uint64_t level_hash; // see hash_level
+  std::string level; // in the text format of the data folder
+  std::vector<int64_t> best_scores; // index 0 is the initial population
+  bool landed;
+  double milliseconds;
+  };
+
+/*
+ FNV-1a hash of the text of a level.
+ */
+uint64_t hash_level(const std::string& text);
+
+/*
+ Fills the inputs of m for solving the level with the text level_text (see write_level) with the engine of s
+ and the current elitarism_factor and mutation_chance. The results (best_scores, landed, milliseconds) are cleared.
+ */
+void begin_manifest(run_manifest& m, const std::string& level_text, const solver& s, int seed, int population, int max_generations);
+
+/*
+ Writes m as a single JSON line.
+ */
+void write_manifest(std::ostream& os, const run_manifest& m);
+
+/*
+ Reads a file of JSON lines written by write_manifest.
+ */
+bool read_manifests(std::vector<run_manifest>& out, const char* filename, std::string& error);
+
+struct replay_result
+  {
+  bool identical; // every generation has the recorded best score, and the landing matches
+  int first_mismatch; // generation of the first different best score, -1 if none
+  int64_t expected_score, actual_score; // at first_mismatch
+  bool landed;
+  double milliseconds;
+  };
+
+/*
+ Solves the level of m again with its seed, engine and parameters for the recorded number of generations,
+ and compares the best score of every generation. The level and the solver globals
+ (elitarism_factor, mutation_chance, the random generator of the calling thread) are overwritten.
+ Returns false if the level of m cannot be parsed or does not match its hash.
+ */
+bool replay(replay_result& result, const run_manifest& m, std::string& error);
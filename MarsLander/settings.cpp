@@ -7,19 +7,38 @@ settings read_settings(const char* filename)
   {
   settings s;
   s.fullscreen = false;
+  s.heatmap = false;
+  s.render_on_demand = true;
   s.log_window = true; 
   s.script_window = true;
   s.controls = true;
+  s.profiler_window = false;
   s.iterations_per_visualization = 1;
+  s.adaptive_iterations = false;
+  s.frame_budget_ms = 12.0;
+  s.population = 200;
   s.elitarism_factor = 0.1;
   s.mutation_chance = 0.01;
+  s.checkpoint_file = "marslander.ckpt";
+  s.checkpoint_interval = 1000;
   pref_file f(filename, pref_file::READ);
   f["file_open_folder"] >> s.file_open_folder;
+  f["log_file"] >> s.log_file;
+  f["metrics_file"] >> s.metrics_file;
+  f["checkpoint_file"] >> s.checkpoint_file;
+  f["checkpoint_interval"] >> s.checkpoint_interval;
+  f["publication_name"] >> s.publication_name;
   f["log_window"] >> s.log_window;
   f["script_window"] >> s.script_window;
   f["controls"] >> s.controls;
+  f["profiler_window"] >> s.profiler_window;
   f["fullscreen"] >> s.fullscreen;
+  f["heatmap"] >> s.heatmap;
+  f["render_on_demand"] >> s.render_on_demand;
   f["iterations_per_visualization"] >> s.iterations_per_visualization;
+  f["adaptive_iterations"] >> s.adaptive_iterations;
+  f["frame_budget_ms"] >> s.frame_budget_ms;
+  f["population_size"] >> s.population;
   f["elitarism_factor"] >> s.elitarism_factor;
   f["mutation_chance"] >> s.mutation_chance;
   return s;
@@ -29,10 +48,21 @@ void write_settings(const settings& s, const char* filename)
   {
   pref_file f(filename, pref_file::WRITE);
   f << "file_open_folder" << s.file_open_folder;
+  f << "log_file" << s.log_file;
+  f << "metrics_file" << s.metrics_file;
+  f << "checkpoint_file" << s.checkpoint_file;
+  f << "checkpoint_interval" << s.checkpoint_interval;
+  f << "publication_name" << s.publication_name;
   f << "script_window" << s.script_window;
   f << "controls" << s.controls;
+  f << "profiler_window" << s.profiler_window;
   f << "fullscreen" << s.fullscreen;
+  f << "heatmap" << s.heatmap;
+  f << "render_on_demand" << s.render_on_demand;
   f << "iterations_per_visualization" << s.iterations_per_visualization;
+  f << "adaptive_iterations" << s.adaptive_iterations;
+  f << "frame_budget_ms" << s.frame_budget_ms;
+  f << "population_size" << s.population;
   f << "elitarism_factor" << s.elitarism_factor;
   f << "mutation_chance" << s.mutation_chance;
   f.release();
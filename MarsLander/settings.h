@@ -5,11 +5,22 @@
 struct settings
   {
   std::string file_open_folder;
+  std::string log_file; // if not empty, log records are appended to this file
+  std::string metrics_file; // if not empty, per generation metrics are written to this .csv or .jsonl file
+  std::string checkpoint_file; // if not empty, the search is checkpointed to this file, see checkpoint.h
+  int checkpoint_interval; // generations between checkpoints
+  std::string publication_name; // if not empty, the best trajectory is published in the shared memory segment of this name, see publisher.h
   bool log_window;
   bool script_window;
   bool controls;
+  bool profiler_window;
   bool fullscreen;
+  bool heatmap; // draw the population as a density heatmap instead of line strips
+  bool render_on_demand; // only redraw after input or a new snapshot, instead of at vsync rate
   int iterations_per_visualization;
+  bool adaptive_iterations; // if true, run as many generations per view as fit in frame_budget_ms instead
+  double frame_budget_ms;
+  int population; // number of chromosomes, applied on Start
   double elitarism_factor;
   double mutation_chance;
   };
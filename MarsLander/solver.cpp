@@ -0,0 +1,172 @@
+#include "solver.h"
+#include "checkpoint.h"
+#include "publisher.h"
+#include "metrics.h"
+#include "trace.h"
+
+#include <chrono>
+#include <cstring>
+
+namespace
+  {
+  // Returns the milliseconds since t and resets t to now.
+  double lap_ms(std::chrono::steady_clock::time_point& t)
+    {
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    const double ms = std::chrono::duration<double, std::milli>(now - t).count();
+    t = now;
+    return ms;
+    }
+  }
+
+const char* engine_name(solver_engine e)
+  {
+  switch (e)
+    {
+    case engine_beam: return "beam";
+    case engine_differential: return "differential";
+    case engine_macro: return "macro";
+    default: return "genetic";
+    }
+  }
+
+bool parse_engine(solver_engine& e, const char* name)
+  {
+  for (solver_engine candidate : { engine_genetic, engine_beam, engine_differential, engine_macro })
+    {
+    if (strcmp(name, engine_name(candidate)) == 0)
+      {
+      e = candidate;
+      return true;
+      }
+    }
+  return false;
+  }
+
+void init_solver(solver& s, int size)
+  {
+#if defined(MARSLANDER_COUNTERS)
+  clear(thread_counters);
+#endif
+  s.next_population.clear();
+  if (s.engine == engine_macro)
+    {
+    s.macro.current = generate_random_macro_population(size, s.macro.hold);
+    s.macro.next.clear();
+    evaluate_macro_population(s.scores, s.macro.current, s.macro.hold, s.current_population, s.record_paths ? &s.paths : nullptr);
+    }
+  else
+    {
+    if (s.engine == engine_beam)
+      {
+      init_beam(s.beam);
+      beam_population(s.current_population, s.beam, size);
+      }
+    else
+      s.current_population = generate_random_population(size);
+    evaluate_population(s.scores, s.current_population, s.record_paths ? &s.paths : nullptr);
+    }
+  if (s.engine == engine_differential)
+    init_differential(s.differential, s.current_population); // after evaluate, which corrects the final genes
+  normalize_scores_roulette_wheel(s.current_population_normalized_score, s.scores);
+  s.generation = 0;
+  if (s.best_scores)
+    s.best_scores->push_back(best_score(s));
+#if defined(MARSLANDER_COUNTERS)
+  s.counters = thread_counters;
+  s.total_counters = thread_counters;
+#endif
+  }
+
+void run_generation(solver& s)
+  {
+  trace_scope trace("generation");
+#if defined(MARSLANDER_COUNTERS)
+  clear(thread_counters);
+#endif
+  std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+  if (s.engine == engine_differential)
+    {
+    // the survivors keep their scores, so only the trials are evaluated
+    make_trials(s.differential, s.scores);
+    s.breeding_ms = lap_ms(t);
+    evaluate_population(s.differential.trial_scores, s.differential.trials, s.record_paths ? &s.differential.trial_paths : nullptr);
+    select_trials(s.differential, s.current_population, s.scores, s.record_paths ? &s.paths : nullptr);
+    s.evaluation_ms = lap_ms(t);
+    }
+  else if (s.engine == engine_macro)
+    {
+    make_next_generation(s.macro.next, s.macro.current, s.current_population_normalized_score, generate_random_target);
+    std::swap(s.macro.current, s.macro.next);
+    s.breeding_ms = lap_ms(t);
+    evaluate_macro_population(s.scores, s.macro.current, s.macro.hold, s.current_population, s.record_paths ? &s.paths : nullptr);
+    s.evaluation_ms = lap_ms(t);
+    }
+  else
+    {
+    if (s.engine == engine_beam)
+      {
+      expand_beam(s.beam);
+      beam_population(s.current_population, s.beam, (int)s.current_population.size());
+      }
+    else
+      {
+      make_next_generation(s.next_population, s.current_population, s.current_population_normalized_score);
+      std::swap(s.current_population, s.next_population);
+      }
+    s.breeding_ms = lap_ms(t);
+    evaluate_population(s.scores, s.current_population, s.record_paths ? &s.paths : nullptr);
+    s.evaluation_ms = lap_ms(t);
+    }
+  normalize_scores_roulette_wheel(s.current_population_normalized_score, s.scores);
+  s.selection_ms = lap_ms(t);
+  ++s.generation;
+#if defined(MARSLANDER_COUNTERS)
+  s.counters = thread_counters;
+  add(s.total_counters, s.counters);
+#endif
+  if (s.prof)
+    {
+    s.prof->add(phase_breeding, s.breeding_ms);
+    s.prof->add(phase_evaluation, s.evaluation_ms);
+    s.prof->add(phase_selection, s.selection_ms);
+    }
+  if (s.best_scores)
+    s.best_scores->push_back(best_score(s));
+  if (s.metrics)
+    {
+    generation_metrics m;
+    compute_metrics(m, s);
+    s.metrics->push(m);
+    }
+  // a checkpoint holds no beam, vectors or macro chromosomes, so only the genetic engine can be resumed
+  if (s.checkpoints && s.engine == engine_genetic && s.checkpoint_interval > 0 && s.generation % s.checkpoint_interval == 0)
+    s.checkpoints->push(s);
+  }
+
+int64_t best_score(const solver& s)
+  {
+  return s.scores[get_best_index(s.current_population_normalized_score)];
+  }
+
+bool best_is_a_valid_landing(const solver& s, simulation_data& sd, simulation_data& prev_sd)
+  {
+  run_chromosome(sd, prev_sd, s.current_population[get_best_index(s.current_population_normalized_score)]);
+  return is_a_valid_landing(sd, prev_sd);
+  }
+
+bool solve(solver& s, int max_generations)
+  {
+  simulation_data sd, prev_sd;
+  for (;;)
+    {
+    const bool valid_landing = best_is_a_valid_landing(s, sd, prev_sd);
+    if (s.publisher)
+      s.publisher->publish(s, sd, prev_sd, valid_landing, s.generation >= max_generations); // the state the run ends in
+    if (valid_landing)
+      return true;
+    if (s.generation >= max_generations)
+      return false;
+    run_generation(s);
+    }
+  }
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "beam_engine.h"
+#include "cgalgo.h"
+#include "counters.h"
+#include "differential_engine.h"
+#include "macro_engine.h"
+#include "profiler.h"
+
+class checkpoint_writer;
+class metrics_writer;
+class trajectory_publisher;
+
+/*
+ The search that produces the next generation. Every engine keeps current_population with its
+ scores, so evaluation, solve and everything that reports on a generation are shared.
+ */
+enum solver_engine
+  {
+  engine_genetic, // make_next_generation, see cgalgo.h
+  engine_beam, // the population is the front of a beam search, see beam_engine.h
+  engine_differential, // differential evolution over real valued genes, see differential_engine.h
+  engine_macro // make_next_generation over genes that hold for several steps, see macro_engine.h
+  };
+
+const char* engine_name(solver_engine e);
+
+// Accepts the names returned by engine_name.
+bool parse_engine(solver_engine& e, const char* name);
+
+/*
+ Headless state of the solver, used by the command line tools.
+ The level is taken from the globals in cgalgo.h (see set_level).
+ */
+struct solver
+  {
+  solver_engine engine = engine_genetic; // applied by init_solver
+  beam_search beam;
+  differential_evolution differential;
+  macro_search macro;
+  population current_population, next_population;
+  std::vector<int64_t> scores;
+  std::vector<double> current_population_normalized_score;
+  int generation;
+  bool record_paths = false; // if true, paths holds the trajectories of current_population, see evaluate_population
+  std::vector<vec2<int16_t>> paths;
+  profiler* prof = nullptr; // if not null, run_generation times its phases
+  metrics_writer* metrics = nullptr; // if not null, run_generation pushes a record per generation
+  int run = 0; // identifies the search in the metrics, e.g. the index of the level
+  double selection_ms = 0.0, breeding_ms = 0.0, evaluation_ms = 0.0; // of the last generation
+  hot_path_counters counters = hot_path_counters(); // of the last generation, only counted with MARSLANDER_COUNTERS
+  hot_path_counters total_counters = hot_path_counters(); // since init_solver
+  checkpoint_writer* checkpoints = nullptr; // if not null, run_generation of the genetic engine pushes a checkpoint every checkpoint_interval generations
+  int checkpoint_interval = 1000;
+  trajectory_publisher* publisher = nullptr; // if not null, solve publishes the best trajectory of every generation, see publisher.h
+  std::vector<int64_t>* best_scores = nullptr; // if not null, init_solver and run_generation append the raw score of the best chromosome
+  };
+
+/*
+ Makes the first population of the given size and evaluates it: a random one,
+ or for the beam engine the initial state of a new search.
+ For the macro engine the random population is in macro.current, and current_population holds its expansions.
+ */
+void init_solver(solver& s, int size = population_size);
+
+/*
+ Breeds the next generation, or advances the beam by one step, and evaluates it.
+ The differential engine evaluates a trial per chromosome, and keeps the better of both.
+ */
+void run_generation(solver& s);
+
+/*
+ Returns the raw score of the best chromosome of the current generation, see evaluate.
+ */
+int64_t best_score(const solver& s);
+
+/*
+ Runs the best chromosome of the current generation and returns whether it lands.
+ */
+bool best_is_a_valid_landing(const solver& s, simulation_data& sd, simulation_data& prev_sd);
+
+/*
+ Runs generations until the best chromosome lands or max_generations is reached.
+ Returns true on a valid landing.
+ */
+bool solve(solver& s, int max_generations);
@@ -0,0 +1,210 @@
+#include "solver_thread.h"
+#include "logging.h"
+#include "trace.h"
+
+solver_thread::solver_thread() : _profiler(nullptr), _metrics(nullptr), _checkpoints(nullptr), _checkpoint_interval(0), _publisher(nullptr),
+_run_index(0), _restore_random_state(false), _random_state{}, _quit(false), _playing(false), _pending_generations(0), _checkpoint_requested(false),
+_elitarism_factor(elitarism_factor), _mutation_chance(mutation_chance), _generations_per_snapshot(1),
+_frame_budget_ms(0.0), _generations_per_second(0.0), _generation_ms(0.0)
+  {
+  }
+
+solver_thread::~solver_thread()
+  {
+  stop();
+  }
+
+void solver_thread::restart(const population& p, const std::vector<int64_t>& scores)
+  {
+  stop();
+  _s.current_population = p;
+  _s.scores = scores;
+  normalize_scores_roulette_wheel(_s.current_population_normalized_score, _s.scores);
+  _s.generation = 0;
+  _restore_random_state = false;
+  _start();
+  }
+
+void solver_thread::resume(const checkpoint& c)
+  {
+  stop();
+  restore_solver(_s, c);
+  // the generator is thread local, so the worker restores it itself
+  std::copy(c.random_state, c.random_state + 4, _random_state);
+  _restore_random_state = true;
+  _start();
+  }
+
+void solver_thread::_start()
+  {
+  _s.record_paths = true;
+  _s.prof = _profiler;
+  _s.metrics = _metrics;
+  _s.checkpoints = _checkpoints;
+  _s.checkpoint_interval = _checkpoint_interval;
+  _s.publisher = _publisher;
+  _s.run = _run_index++;
+  _quit = false;
+  _thread = std::thread(&solver_thread::_run, this);
+  }
+
+void solver_thread::stop()
+  {
+  if (_thread.joinable())
+    {
+      {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _quit = true;
+      _playing = false;
+      _pending_generations = 0;
+      }
+    _wake_up.notify_one();
+    _thread.join();
+    }
+  }
+
+void solver_thread::play(bool on)
+  {
+    {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _playing = on;
+    }
+  _wake_up.notify_one();
+  }
+
+void solver_thread::run(int generations)
+  {
+    {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _pending_generations += generations;
+    }
+  _wake_up.notify_one();
+  }
+
+void solver_thread::cancel()
+  {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _playing = false;
+  _pending_generations = 0;
+  }
+
+void solver_thread::save_checkpoint()
+  {
+    {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _checkpoint_requested = true;
+    }
+  _wake_up.notify_one();
+  }
+
+void solver_thread::set_parameters(double elitarism, double mutation, int generations_per_snapshot, double frame_budget_ms)
+  {
+  _elitarism_factor = elitarism;
+  _mutation_chance = mutation;
+  _generations_per_snapshot = generations_per_snapshot < 1 ? 1 : generations_per_snapshot;
+  _frame_budget_ms = frame_budget_ms;
+  }
+
+solver_snapshot* solver_thread::poll()
+  {
+  return _snapshots.read();
+  }
+
+void solver_thread::_publish(bool valid_landing)
+  {
+  scoped_timer t(_profiler, phase_snapshot);
+  trace_scope trace("snapshot");
+  Logging::Debug() << "snapshot of generation " << _s.generation << "\n";
+#if defined(MARSLANDER_COUNTERS)
+  Logging::Debug() << "generation " << _s.generation << ": " << _s.counters << "\n";
+#endif
+  solver_snapshot& snap = _snapshots.write_buffer();
+  snap.current_population = _s.current_population;
+  snap.current_population_normalized_score = _s.current_population_normalized_score;
+  std::swap(snap.paths, _s.paths); // the next generation overwrites the paths anyway
+  snap.generation = _s.generation;
+  snap.valid_landing = valid_landing;
+  _snapshots.publish();
+  if (_on_publish)
+    _on_publish();
+  }
+
+void solver_thread::_run()
+  {
+  Tracing::set_thread_name("solver");
+  if (_restore_random_state)
+    set_random_state(_random_state);
+  typedef std::chrono::steady_clock clock;
+  int generations_since_snapshot = 0;
+  clock::time_point snapshot_start = clock::now();
+  clock::time_point rate_start = snapshot_start;
+  int rate_generations = 0;
+  for (;;)
+    {
+      {
+      std::unique_lock<std::mutex> lock(_mutex);
+      if (!busy())
+        {
+        _generations_per_second = 0.0;
+        _wake_up.wait(lock, [this]() { return _quit || busy() || _checkpoint_requested; });
+        snapshot_start = rate_start = clock::now();
+        rate_generations = 0;
+        }
+      if (_quit)
+        return;
+      }
+    if (_checkpoint_requested.exchange(false) && _s.checkpoints)
+      _s.checkpoints->push(_s);
+    if (!busy())
+      continue;
+    // parameters are only read at generation boundaries
+    elitarism_factor = _elitarism_factor;
+    mutation_chance = _mutation_chance;
+    const clock::time_point generation_start = clock::now();
+    run_generation(_s);
+    const clock::time_point generation_end = clock::now();
+    ++generations_since_snapshot;
+
+    // exponential smoothing, so that a single slow generation does not halve the batch
+    const double ms = std::chrono::duration<double, std::milli>(generation_end - generation_start).count();
+    _generation_ms = _generation_ms == 0.0 ? ms : _generation_ms + 0.1 * (ms - _generation_ms);
+    ++rate_generations;
+    const double rate_seconds = std::chrono::duration<double>(generation_end - rate_start).count();
+    if (rate_seconds >= 0.5)
+      {
+      _generations_per_second = rate_generations / rate_seconds;
+      rate_start = generation_end;
+      rate_generations = 0;
+      }
+    int pending = _pending_generations;
+    while (pending > 0 && !_pending_generations.compare_exchange_weak(pending, pending - 1))
+      ;
+
+    simulation_data sd, prev_sd;
+    const bool landed = best_is_a_valid_landing(_s, sd, prev_sd);
+    if (_s.publisher)
+      _s.publisher->publish(_s, sd, prev_sd, landed);
+    if (landed)
+      {
+      Logging::Info() << "Valid landing found in generation " << _s.generation << "\n";
+#if defined(MARSLANDER_COUNTERS)
+      Logging::Info() << "Work done: " << _s.total_counters << "\n";
+#endif
+      _playing = false;
+      _pending_generations = 0;
+      }
+    const bool batch_done = !busy();
+    bool snapshot_due;
+    const double frame_budget_ms = _frame_budget_ms;
+    if (frame_budget_ms > 0.0)
+      snapshot_due = std::chrono::duration<double, std::milli>(generation_end - snapshot_start).count() + _generation_ms > frame_budget_ms;
+    else
+      snapshot_due = generations_since_snapshot >= _generations_per_snapshot;
+    if (batch_done || (snapshot_due && !_snapshots.has_new()))
+      {
+      _publish(landed);
+      generations_since_snapshot = 0;
+      snapshot_start = clock::now();
+      }
+    }
+  }
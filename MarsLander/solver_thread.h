@@ -0,0 +1,135 @@
+#pragma once
+
+#include "checkpoint.h"
+#include "publisher.h"
+#include "solver.h"
+#include "triple_buffer.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/*
+ Immutable view on a generation, handed from the solver thread to the ui.
+ */
+struct solver_snapshot
+  {
+  population current_population;
+  std::vector<double> current_population_normalized_score;
+  std::vector<vec2<int16_t>> paths; // recorded while scoring, see evaluate_population
+  int generation;
+  bool valid_landing;
+  };
+
+/*
+ Runs the genetic algorithm on a worker thread.
+
+ The ui controls it with play/run/set_parameters, which take effect at the next generation
+ boundary, and picks up results with poll(). Snapshots are exchanged through a triple buffer,
+ so neither thread waits for the other. A new snapshot is only assembled after the ui has
+ taken the previous one, so the solver does not pay for copies nobody looks at.
+ */
+class solver_thread
+  {
+  public:
+    solver_thread();
+    ~solver_thread();
+
+    /*
+     Stops the worker and starts a new search from population p with the given scores.
+     The level must be set (see set_level) before, and must not change while the worker runs.
+     */
+    void restart(const population& p, const std::vector<int64_t>& scores);
+
+    /*
+     Stops the worker and continues the search of c, including its random generator.
+     The level of c must be set before, see restart.
+     */
+    void resume(const checkpoint& c);
+
+    void stop();
+
+    void play(bool on);
+    bool playing() const { return _playing; }
+
+    // Queues the given number of generations.
+    void run(int generations);
+
+    // Stops playing and drops the queued generations, the current generation is finished.
+    void cancel();
+
+    // True while the worker has generations to compute.
+    bool busy() const { return _playing || _pending_generations > 0; }
+
+    /*
+     If frame_budget_ms > 0, a snapshot is published as soon as the next generation would no longer
+     fit in frame_budget_ms since the previous snapshot, based on the smoothed cost of a generation.
+     Otherwise a snapshot is published every generations_per_snapshot generations.
+     */
+    void set_parameters(double elitarism, double mutation, int generations_per_snapshot, double frame_budget_ms = 0.0);
+
+    // Times the phases of every generation into p, applied on the next restart.
+    void set_profiler(profiler* p) { _profiler = p; }
+
+    // Pushes a record per generation to m, applied on the next restart. Every restart is a new run.
+    void set_metrics(metrics_writer* m) { _metrics = m; }
+
+    // Pushes a checkpoint to w every interval generations, applied on the next restart.
+    void set_checkpoints(checkpoint_writer* w, int interval) { _checkpoints = w; _checkpoint_interval = interval; }
+
+    // Publishes the best trajectory of every generation to p, applied on the next restart.
+    void set_publisher(trajectory_publisher* p) { _publisher = p; }
+
+    // Pushes a checkpoint of the current generation as soon as possible, also while idle.
+    void save_checkpoint();
+
+    // Called on the worker thread after every published snapshot, e.g. to wake up the ui.
+    // Must be set while the worker is stopped.
+    void set_publish_callback(std::function<void()> f) { _on_publish = std::move(f); }
+
+    // Achieved throughput, measured over the last half second. 0 while idle.
+    double generations_per_second() const { return _generations_per_second; }
+
+    // Smoothed wall time of a single generation.
+    double generation_ms() const { return _generation_ms; }
+
+    /*
+     Returns the newest snapshot if one was published since the last call, nullptr otherwise.
+     The snapshot may be modified by the caller and stays valid until the next call.
+     */
+    solver_snapshot* poll();
+
+  private:
+    void _start();
+    void _run();
+    void _publish(bool valid_landing);
+
+  private:
+    solver _s;
+    profiler* _profiler;
+    metrics_writer* _metrics;
+    checkpoint_writer* _checkpoints;
+    int _checkpoint_interval;
+    trajectory_publisher* _publisher;
+    int _run_index;
+    bool _restore_random_state;
+    uint64_t _random_state[4];
+    std::function<void()> _on_publish;
+    triple_buffer<solver_snapshot> _snapshots;
+    std::thread _thread;
+    std::mutex _mutex; // only guards sleeping while idle
+    std::condition_variable _wake_up;
+    std::atomic<bool> _quit;
+    std::atomic<bool> _playing;
+    std::atomic<int> _pending_generations;
+    std::atomic<bool> _checkpoint_requested;
+    std::atomic<double> _elitarism_factor;
+    std::atomic<double> _mutation_chance;
+    std::atomic<int> _generations_per_snapshot;
+    std::atomic<double> _frame_budget_ms;
+    std::atomic<double> _generations_per_second;
+    std::atomic<double> _generation_ms;
+  };
@@ -0,0 +1,177 @@
+#include "trace.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+  {
+#define trace_buffer_size 65536
+
+  struct trace_event
+    {
+    const char* name;
+    int64_t begin_ns, end_ns;
+    };
+
+  struct trace_buffer
+    {
+    trace_event events[trace_buffer_size];
+    std::atomic<uint32_t> count; // written by the owning thread only
+    std::atomic<uint32_t> epoch; // the start the events belong to, written by the owning thread only
+    std::atomic<const char*> name;
+    std::atomic<bool> in_use;
+
+    trace_buffer() : count(0), epoch(0), name(nullptr), in_use(false) {}
+    };
+
+  struct trace_registry
+    {
+    std::mutex mutex; // guards buffers, never taken while recording to an existing buffer
+    std::vector<std::unique_ptr<trace_buffer>> buffers;
+    std::atomic<uint32_t> epoch; // incremented by start, owners empty their buffer when it changes
+    std::atomic<uint64_t> dropped;
+    std::chrono::steady_clock::time_point start;
+
+    trace_registry() : epoch(0), dropped(0), start(std::chrono::steady_clock::now()) {}
+    };
+
+  trace_registry& registry()
+    {
+    static trace_registry r;
+    return r;
+    }
+
+  struct thread_buffer
+    {
+    trace_buffer* buffer = nullptr;
+
+    ~thread_buffer()
+      {
+      if (buffer)
+        buffer->in_use = false;
+      }
+    };
+
+  thread_local thread_buffer current_buffer;
+
+  trace_buffer* get_buffer()
+    {
+    if (!current_buffer.buffer)
+      {
+      trace_registry& r = registry();
+      std::lock_guard<std::mutex> lock(r.mutex);
+      for (auto& b : r.buffers)
+        {
+        if (!b->in_use)
+          {
+          current_buffer.buffer = b.get();
+          break;
+          }
+        }
+      if (!current_buffer.buffer)
+        {
+        r.buffers.emplace_back(new trace_buffer());
+        current_buffer.buffer = r.buffers.back().get();
+        }
+      current_buffer.buffer->in_use = true;
+      current_buffer.buffer->name = nullptr;
+      }
+    return current_buffer.buffer;
+    }
+  }
+
+std::atomic<bool> Tracing::_enabled(false);
+
+void Tracing::start()
+  {
+  trace_registry& r = registry();
+  r.dropped = 0;
+  r.epoch.fetch_add(1, std::memory_order_release);
+  _enabled = true;
+  }
+
+void Tracing::stop()
+  {
+  _enabled = false;
+  }
+
+void Tracing::set_thread_name(const char* name)
+  {
+  get_buffer()->name = name;
+  }
+
+uint64_t Tracing::dropped()
+  {
+  return registry().dropped;
+  }
+
+int64_t Tracing::_now_ns()
+  {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - registry().start).count();
+  }
+
+void Tracing::_record(const char* name, int64_t begin_ns, int64_t end_ns)
+  {
+  trace_buffer* b = get_buffer();
+  const uint32_t epoch = registry().epoch.load(std::memory_order_acquire);
+  if (b->epoch.load(std::memory_order_relaxed) != epoch)
+    {
+    b->count.store(0, std::memory_order_relaxed);
+    b->epoch.store(epoch, std::memory_order_release);
+    }
+  const uint32_t n = b->count.load(std::memory_order_relaxed);
+  if (n >= trace_buffer_size)
+    {
+    ++registry().dropped;
+    return;
+    }
+  trace_event& e = b->events[n];
+  e.name = name;
+  e.begin_ns = begin_ns;
+  e.end_ns = end_ns;
+  b->count.store(n + 1, std::memory_order_release);
+  }
+
+bool Tracing::dump(const char* filename, std::string& error)
+  {
+  std::ofstream f(filename);
+  if (!f.is_open())
+    {
+    error = std::string("cannot create ") + filename;
+    return false;
+    }
+  trace_registry& r = registry();
+  const uint32_t epoch = r.epoch.load(std::memory_order_acquire);
+  std::lock_guard<std::mutex> lock(r.mutex);
+  f << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  bool first = true;
+  for (size_t tid = 0; tid < r.buffers.size(); ++tid)
+    {
+    const trace_buffer& b = *r.buffers[tid];
+    // buffers that did not record since start still hold events of an older trace
+    if (b.epoch.load(std::memory_order_acquire) != epoch)
+      continue;
+    const uint32_t n = b.count.load(std::memory_order_acquire);
+    const char* name = b.name;
+    if (name)
+      {
+      f << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid << ",\"args\":{\"name\":\"" << name << "\"}}";
+      first = false;
+      }
+    for (uint32_t i = 0; i < n; ++i)
+      {
+      const trace_event& e = b.events[i];
+      char line[256];
+      snprintf(line, sizeof(line), "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+        e.name, (int)tid, e.begin_ns / 1000.0, (e.end_ns - e.begin_ns) / 1000.0);
+      f << (first ? "" : ",\n") << line;
+      first = false;
+      }
+    }
+  f << "\n]}\n";
+  return true;
+  }
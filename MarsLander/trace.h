@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+/*
+ Records timelines in the Trace Event Format of chrome://tracing and Perfetto.
+
+ Every thread that traces owns a buffer of trace_buffer_size events. The first event of a thread
+ takes a buffer under a lock, and allocates one only if no buffer is free; after that recording
+ never blocks or allocates. Buffers of threads that have exited are reused by new threads, which
+ keeps the threads that parallel_for starts when the worker_pool is busy on a stable row of the
+ timeline. When a buffer is full, further events of that thread are dropped and counted.
+
+ start, stop and dump must only be called from one thread at a time (the ui or the main thread
+ of the command line tools).
+ */
+class Tracing
+  {
+  public:
+    // Forgets the events recorded so far and starts recording.
+    static void start();
+
+    static void stop();
+
+    static bool enabled() { return _enabled.load(std::memory_order_relaxed); }
+
+    // Names the row of the calling thread in the timeline, name must outlive the trace.
+    static void set_thread_name(const char* name);
+
+    // Writes the events recorded since start. Recording may continue while dumping.
+    static bool dump(const char* filename, std::string& error);
+
+    // Number of events that were dropped because a buffer was full.
+    static uint64_t dropped();
+
+  private:
+    friend class trace_scope;
+    static void _record(const char* name, int64_t begin_ns, int64_t end_ns);
+    static int64_t _now_ns();
+
+  private:
+    static std::atomic<bool> _enabled;
+  };
+
+/*
+ Records the lifetime of the scope as one event. name must be a string literal.
+ If tracing is disabled this costs a single branch.
+ */
+class trace_scope
+  {
+  public:
+    trace_scope(const char* name) : _name(Tracing::enabled() ? name : nullptr), _begin_ns(0)
+      {
+      if (_name)
+        _begin_ns = Tracing::_now_ns();
+      }
+
+    ~trace_scope()
+      {
+      if (_name)
+        Tracing::_record(_name, _begin_ns, Tracing::_now_ns());
+      }
+
+    trace_scope(const trace_scope&) = delete;
+    void operator=(const trace_scope&) = delete;
+
+  private:
+    const char* _name;
+    int64_t _begin_ns;
+  };
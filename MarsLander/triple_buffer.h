@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+
+/*
+ Lock-free single producer, single consumer exchange of the latest value.
+
+ The writer fills write_buffer() and calls publish(), the reader calls read() which returns
+ the most recently published value, or nullptr if nothing was published since the last read.
+ Neither side ever blocks or sees a half written value: the three buffers are owned by the
+ writer (back), the reader (front) and the exchange (middle), and only indices are swapped.
+ */
+template <class T>
+class triple_buffer
+  {
+  public:
+    triple_buffer() : _middle(1), _back(0), _front(2)
+      {
+      }
+
+    T& write_buffer()
+      {
+      return _buffers[_back];
+      }
+
+    void publish()
+      {
+      _back = _middle.exchange(_back | fresh_bit) & index_mask;
+      }
+
+    // True if a published value has not been read yet.
+    bool has_new() const
+      {
+      return (_middle.load() & fresh_bit) != 0;
+      }
+
+    T* read()
+      {
+      if (!has_new())
+        return nullptr;
+      _front = _middle.exchange(_front) & index_mask;
+      return &_buffers[_front];
+      }
+
+  private:
+    enum
+      {
+      index_mask = 3,
+      fresh_bit = 4
+      };
+
+    T _buffers[3];
+    std::atomic<int> _middle;
+    int _back, _front;
+  };
@@ -15,12 +15,17 @@
 #include <chrono>
 #include <string>
 #include <fstream>
+#include <sstream>
 #include <streambuf>
 #include <ctime>
 #include <iomanip>
 #include <cmath>
+#include <cfloat>
+#include <cstdio>
 
+#include "generator.h"
 #include "logging.h"
+#include "trace.h"
 
 #define V_W 800
 #define V_H 450
@@ -29,8 +34,9 @@
 
 view::view() : _w(1600), _h(900), _quit(false),
 _vbo_array_blit(nullptr), _vbo_index_blit(nullptr), _vao_blit(nullptr),
-_program(nullptr), _program_blit(nullptr), _viewport_w(V_W), _viewport_h(V_H), _fbo(nullptr),
-_viewport_pos_x(V_X), _viewport_pos_y(V_Y)
+_program(nullptr), _path_program(nullptr), _program_blit(nullptr), _viewport_w(V_W), _viewport_h(V_H), _fbo(nullptr),
+_viewport_pos_x(V_X), _viewport_pos_y(V_Y), _heatmap_program(nullptr), _tone_map_program(nullptr), _vao_heatmap(nullptr),
+_heatmap_fbo(0), _heatmap_texture(0)
   {
   // Setup window
   SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
@@ -74,7 +80,28 @@ _viewport_pos_x(V_X), _viewport_pos_y(V_Y)
 
   SDL_GL_MakeCurrent(_window, gl_context);
 
+  Tracing::set_thread_name("ui");
   _settings = read_settings("marslander.cfg");
+  if (!_settings.log_file.empty())
+    {
+    std::string error;
+    if (!Logging::set_file(_settings.log_file.c_str(), error))
+      Logging::Error() << error << "\n";
+    }
+  if (!_settings.metrics_file.empty())
+    {
+    std::string error;
+    if (!_metrics.open(_settings.metrics_file.c_str(), error))
+      Logging::Error() << error << "\n";
+    }
+  if (!_settings.checkpoint_file.empty())
+    _checkpoints.open(_settings.checkpoint_file.c_str());
+  if (!_settings.publication_name.empty())
+    {
+    std::string error;
+    if (!_publisher.open(_settings.publication_name.c_str(), error))
+      Logging::Error() << error << "\n";
+    }
 
   _setup_gl_objects();
   _setup_blit_gl_objects(_settings.fullscreen);
@@ -90,6 +117,7 @@ _viewport_pos_x(V_X), _viewport_pos_y(V_Y)
   _md.prev_mouse_x = 0.f;
   _md.prev_mouse_y = 0.f;
   _md.wheel_rotation = 0.f;
+  _reset_camera();
 
   _script = R"(7
   0 100
@@ -128,19 +156,29 @@ _viewport_pos_x(V_X), _viewport_pos_y(V_Y)
 6500 2600 -20 0 1000 45 0
   )";
   */
-  init_model(_m, _script);
-  make_random_population(_m);
-  simulate_population(_m);
+  _update_solver_parameters();
+  _solver.set_profiler(&_profiler);
+  if (_metrics.is_open())
+    _solver.set_metrics(&_metrics);
+  if (_checkpoints.is_open())
+    _solver.set_checkpoints(&_checkpoints, std::max(1, _settings.checkpoint_interval));
+  if (_publisher.is_open())
+    _solver.set_publisher(&_publisher);
+  _solver.set_publish_callback([]()
+    {
+    SDL_Event event;
+    SDL_zero(event);
+    event.type = SDL_USEREVENT;
+    SDL_PushEvent(&event);
+    });
+  _restart();
   _prepare_render();
-  _total_iterations = 0;
-  _playing = false;
-  mutation_chance = _settings.mutation_chance;
-  elitarism_factor = _settings.elitarism_factor;
   }
 
 
 view::~view()
   {
+  _solver.stop(); // the worker uses _profiler, _metrics, _checkpoints and _publisher
   write_settings(_settings, "marslander.cfg");
 
   _destroy_gl_objects();
@@ -269,6 +307,36 @@ void view::_setup_blit_gl_objects(bool fullscreen)
   _program_blit->release();
   _vbo_array_blit->release();
   _vbo_index_blit->release();
+
+  _setup_heatmap_gl_objects();
+  }
+
+void view::_setup_heatmap_gl_objects()
+  {
+  using namespace jtk;
+  glGenTextures(1, &_heatmap_texture);
+  glBindTexture(GL_TEXTURE_2D, _heatmap_texture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, _viewport_w, _viewport_h, 0, GL_RED, GL_FLOAT, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  gl_check_error("_heatmap_texture");
+
+  glGenFramebuffers(1, &_heatmap_fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, _heatmap_fbo);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _heatmap_texture, 0);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    Logging::Error() << "The heatmap frame buffer is incomplete\n";
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  gl_check_error("_heatmap_fbo");
+  }
+
+void view::_destroy_heatmap_gl_objects()
+  {
+  glDeleteFramebuffers(1, &_heatmap_fbo);
+  glDeleteTextures(1, &_heatmap_texture);
+  _heatmap_fbo = 0;
+  _heatmap_texture = 0;
   }
 
 void view::_setup_gl_objects()
@@ -282,10 +350,11 @@ void view::_setup_gl_objects()
   precision mediump float;
   precision mediump int;
   layout (location = 0) in vec2 vPosition;
+  uniform vec4 iTransform; // world to clip: xy scale, zw offset
   
   void main()
   {
-  gl_Position = vec4(vPosition, 0.0, 1.0);
+  gl_Position = vec4(vPosition * iTransform.xy + iTransform.zw, 0.0, 1.0);
   }
   )";
 
@@ -312,24 +381,140 @@ void view::_setup_gl_objects()
   gl_check_error("_program->link()");
 
   _program->release();
+
+  std::string path_vertex_shader = R"(#version 330 core
+  precision mediump float;
+  precision mediump int;
+  layout (location = 0) in vec2 vPosition;
+  layout (location = 1) in float vScore;
+  uniform vec4 iTransform; // world to clip: xy scale, zw offset
+  out vec4 Color;
+  
+  void main()
+  {
+  gl_Position = vec4(vPosition * iTransform.xy + iTransform.zw, 0.0, 1.0);
+  Color = vec4(vScore * 0.75, vScore * 0.75, 0.75, 1.0);
+  }
+  )";
+
+  std::string path_fragment = R"(#version 330 core
+  precision mediump float;
+  precision mediump int;
+  in vec4 Color;
+  
+  out vec4 FragColor;
+  
+  void main()
+  {
+  FragColor = Color;
+  }
+  )";
+
+  _path_program = new shader_program();
+  _path_program->add_shader_from_source(shader::shader_type::Vertex, path_vertex_shader);
+  _path_program->add_shader_from_source(shader::shader_type::Fragment, path_fragment);
+  _path_program->link();
+
+  gl_check_error("_path_program->link()");
+
+  _path_program->release();
+
+  // Every fragment of every path adds one to the density, see _accumulate_heatmap.
+  std::string heatmap_fragment = R"(#version 330 core
+  precision mediump float;
+  precision mediump int;
+  
+  out float Density;
+  
+  void main()
+  {
+  Density = 1.0;
+  }
+  )";
+
+  _heatmap_program = new shader_program();
+  _heatmap_program->add_shader_from_source(shader::shader_type::Vertex, vertex_shader);
+  _heatmap_program->add_shader_from_source(shader::shader_type::Fragment, heatmap_fragment);
+  _heatmap_program->link();
+
+  gl_check_error("_heatmap_program->link()");
+
+  _heatmap_program->release();
+
+  std::string tone_map_vertex_shader = R"(#version 330 core
+  precision mediump float;
+  precision mediump int;
+  
+  void main()
+  {
+  // a single triangle that covers the viewport
+  vec2 p = vec2(float((gl_VertexID & 1) << 2) - 1.0, float((gl_VertexID & 2) << 1) - 1.0);
+  gl_Position = vec4(p, 0.0, 1.0);
+  }
+  )";
+
+  std::string tone_map_fragment = R"(#version 330 core
+  precision mediump float;
+  precision mediump int;
+  uniform sampler2D iChannel0;
+  uniform float     iMaxDensity;
+  
+  out vec4 FragColor;
+  
+  void main()
+  {
+  float d = texelFetch(iChannel0, ivec2(gl_FragCoord.xy), 0).r;
+  // logarithmic, so that a single path stays visible next to the start where all paths overlap
+  float t = clamp(log(1.0 + d) / log(1.0 + iMaxDensity), 0.0, 1.0);
+  vec3 heat = clamp(vec3(3.0 * t, 3.0 * t - 1.0, 3.0 * t - 2.0), 0.0, 1.0);
+  FragColor = vec4(mix(vec3(0.2), heat, step(0.5, d) * max(t, 0.25)), 1.0);
+  }
+  )";
+
+  _tone_map_program = new shader_program();
+  _tone_map_program->add_shader_from_source(shader::shader_type::Vertex, tone_map_vertex_shader);
+  _tone_map_program->add_shader_from_source(shader::shader_type::Fragment, tone_map_fragment);
+  _tone_map_program->link();
+
+  gl_check_error("_tone_map_program->link()");
+
+  _tone_map_program->release();
+
+  _vao_heatmap = new vertex_array_object();
+  _vao_heatmap->create();
+  gl_check_error(" _vao_heatmap->create()");
+  _vao_heatmap->release();
   }
 
 void view::_destroy_gl_objects()
   {
   _fbo->release();
   _program->release();
+  _path_program->release();
   _vbo_array_blit->release();
   _vbo_index_blit->release();
   _vao_blit->release();
   _program_blit->release();
+  _heatmap_program->release();
+  _tone_map_program->release();
+  _vao_heatmap->release();
+  _destroy_heatmap_gl_objects();
   delete _fbo;
   delete _program;
+  delete _path_program;
+  delete _heatmap_program;
+  delete _tone_map_program;
+  delete _vao_heatmap;
   delete _vbo_array_blit;
   delete _vbo_index_blit;
   delete _vao_blit;
   delete _program_blit;
   _fbo = nullptr;
   _program = nullptr;
+  _path_program = nullptr;
+  _heatmap_program = nullptr;
+  _tone_map_program = nullptr;
+  _vao_heatmap = nullptr;
   _vbo_array_blit = nullptr;
   _vbo_index_blit = nullptr;
   _vao_blit = nullptr;
@@ -344,6 +529,7 @@ void view::_destroy_blit_gl_objects()
   _vao_blit->release();
   _program_blit->release();
   _fbo->release();
+  _destroy_heatmap_gl_objects();
   delete _vbo_array_blit;
   delete _vbo_index_blit;
   delete _vao_blit;
@@ -356,11 +542,15 @@ void view::_destroy_blit_gl_objects()
   _fbo = nullptr;
   }
 
-void view::_poll_for_events()
+bool view::_poll_for_events(int wait_ms)
   {
   SDL_Event event;
-  while (SDL_PollEvent(&event))
+  bool got_events = false;
+  // only block for the first event, then drain the queue
+  bool have_event = wait_ms > 0 ? SDL_WaitEventTimeout(&event, wait_ms) != 0 : SDL_PollEvent(&event) != 0;
+  while (have_event)
     {
+    got_events = true;
     ImGui_ImplSDL2_ProcessEvent(&event);
     switch (event.type)
       {
@@ -396,6 +586,12 @@ void view::_poll_for_events()
         _md.mouse_x *= width_ratio;
         _md.mouse_y *= height_ratio;
         }
+      if (_md.left_dragging && !ImGui::GetIO().WantCaptureMouse)
+        {
+        const vec2<float> from = _mouse_to_world(_md.prev_mouse_x, _md.prev_mouse_y);
+        const vec2<float> to = _mouse_to_world(_md.mouse_x, _md.mouse_y);
+        _center = _center - (to - from);
+        }
       break;
       }
       case SDL_MOUSEBUTTONDOWN:
@@ -434,10 +630,19 @@ void view::_poll_for_events()
       case SDL_MOUSEWHEEL:
       {
       _md.wheel_rotation += event.wheel.y;
+      if (!ImGui::GetIO().WantCaptureMouse)
+        {
+        // zoom around the point under the mouse
+        const vec2<float> anchor = _mouse_to_world(_md.mouse_x, _md.mouse_y);
+        _zoom = std::max(1.f, std::min(100.f, _zoom * std::pow(1.2f, (float)event.wheel.y)));
+        _center = _center + (anchor - _mouse_to_world(_md.mouse_x, _md.mouse_y));
+        }
       break;
       }
       }
+    have_event = SDL_PollEvent(&event) != 0;
     }
+  return got_events;
   }
 
 void view::_imgui_ui()
@@ -447,6 +652,11 @@ void view::_imgui_ui()
   ImGui_ImplSDL2_NewFrame(_window);
   ImGui::NewFrame();
 
+  const std::string checkpoint_error = _checkpoints.take_error();
+  if (!checkpoint_error.empty())
+    Logging::Error() << checkpoint_error << "\n";
+  _drain_log(); // also while the log window is closed, so that the per thread queues do not fill up
+
   ImGuiWindowFlags window_flags = 0;
   window_flags |= ImGuiWindowFlags_NoTitleBar;
   window_flags |= ImGuiWindowFlags_NoMove;
@@ -461,6 +671,7 @@ void view::_imgui_ui()
   bool open = true;
   static bool open_script = false;
   static bool save_script = false;
+  static bool resume_checkpoint = false;
   if (ImGui::Begin("MarsLander", &open, window_flags))
     {
     if (!open)
@@ -477,6 +688,15 @@ void view::_imgui_ui()
           {
           save_script = true;
           }
+        if (ImGui::MenuItem("Resume checkpoint"))
+          {
+          resume_checkpoint = true;
+          }
+        if (ImGui::MenuItem("Save checkpoint", NULL, false, _checkpoints.is_open()))
+          {
+          _solver.save_checkpoint();
+          Logging::Info() << "Saving checkpoint of generation " << _total_iterations << " to " << _checkpoints.filename() << "\n";
+          }
         if (ImGui::MenuItem("Exit"))
           {
           _quit = true;
@@ -494,6 +714,8 @@ void view::_imgui_ui()
         ImGui::MenuItem("Controls", NULL, &_settings.controls);
         ImGui::MenuItem("Log window", NULL, &_settings.log_window);
         ImGui::MenuItem("Script window", NULL, &_settings.script_window);
+        ImGui::MenuItem("Profiler", NULL, &_settings.profiler_window);
+        ImGui::MenuItem("Render on demand", NULL, &_settings.render_on_demand);
         ImGui::EndMenu();
         }
       ImGui::EndMenuBar();
@@ -510,11 +732,7 @@ void view::_imgui_ui()
     std::ifstream t(openScriptChosenPath);
     std::string str((std::istreambuf_iterator<char>(t)), std::istreambuf_iterator<char>());
     _script = str;
-    init_model(_m, _script);
-    make_random_population(_m);
-    simulate_population(_m);
-    _total_iterations = 0;
-    _playing = false;
+    _restart();
     _print_best_run_results();
     _prepare_render();
     }
@@ -530,6 +748,24 @@ void view::_imgui_ui()
     t.close();
     }
 
+  static ImGuiFs::Dialog resume_checkpoint_dlg(false, true, true);
+  const char* resumeCheckpointChosenPath = resume_checkpoint_dlg.chooseFileDialog(resume_checkpoint, _settings.file_open_folder.c_str(), ".ckpt", "Resume checkpoint", ImVec2(-1, -1), ImVec2(50, 50));
+  resume_checkpoint = false;
+  if (strlen(resumeCheckpointChosenPath) > 0)
+    {
+    _settings.file_open_folder = resume_checkpoint_dlg.getLastDirectory();
+    checkpoint c;
+    std::string error;
+    if (read_checkpoint(c, resumeCheckpointChosenPath, error))
+      {
+      _resume(c);
+      _print_best_run_results();
+      _prepare_render();
+      }
+    else
+      Logging::Error() << error << "\n";
+    }
+
   if (_settings.log_window)
     _log_window();
 
@@ -538,6 +774,9 @@ void view::_imgui_ui()
 
   if (_settings.script_window)
     _script_window();
+
+  if (_settings.profiler_window)
+    _profiler_window();
   ImGui::Render();
   }
 
@@ -556,10 +795,40 @@ void view::_script_window()
   ImGui::End();
   }
 
-void view::_prepare_render()
+void view::_restart()
+  {
+  _solver.stop(); // the worker reads the level, so it cannot run while a new level is loaded
+  init_model(_m, _script);
+  fill_terrain_data(_m);
+  _settings.population = std::max(2, _settings.population + (_settings.population & 1));
+  make_random_population(_m, _settings.population);
+  simulate_population(_m);
+  _total_iterations = 0;
+  _solver.restart(_m.current_population, _m.current_population_scores);
+  }
+
+void view::_resume(const checkpoint& c)
   {
-  _m.delete_render_objects();
+  _solver.stop();
+  std::stringstream str;
+  write_level(str, c.lvl);
+  _script = str.str();
+  init_model(_m, _script);
   fill_terrain_data(_m);
+  _settings.population = (int)c.current_population.size();
+  _settings.elitarism_factor = c.elitarism_factor;
+  _settings.mutation_chance = c.mutation_chance;
+  _update_solver_parameters();
+  _m.current_population = c.current_population;
+  simulate_population(_m); // for the paths, the scores equal those of c
+  _total_iterations = c.generation;
+  _solver.resume(c);
+  Logging::Info() << "Resumed generation " << c.generation << "\n";
+  }
+
+void view::_prepare_render()
+  {
+  scoped_timer t(&_profiler, phase_upload);
   fill_renderer_with_simulation(_m);
   }
 
@@ -577,7 +846,6 @@ void view::_print_best_run_results() {
   Logging::Info() << "  F: " << sd.F << "\n";
 
   if (is_a_valid_landing(sd, prev_sd)) {
-    _playing = false;
     Logging::Warning() << "!!!VALID LANDING!!!\n";
     }
   }
@@ -602,107 +870,239 @@ void view::_control_window()
     }
 
   if (ImGui::Button("Start")) {
-    init_model(_m, _script);
-    make_random_population(_m);
-    simulate_population(_m);
-    _total_iterations = 0;
-    _playing = false;
-    _print_best_run_results();
-    _prepare_render();
-    }
-  if (ImGui::Button("Next")) {
-    _run_simulations(1);
-    _print_best_run_results();
-    _playing = false;
-    _prepare_render();
-    }
-  if (ImGui::Button("Next+10")) {
-    _run_simulations(10);
-    _print_best_run_results();
-    _playing = false;
-    _prepare_render();
-    }
-  if (ImGui::Button("Next+100")) {
-    _run_simulations(100);
-    _print_best_run_results();
-    _playing = false;
-    _prepare_render();
-    }
-  if (ImGui::Button("Next+1000")) {
-    _run_simulations(1000);
+    _restart();
     _print_best_run_results();
-    _playing = false;
     _prepare_render();
     }
-  if (_playing) {
+  if (ImGui::Button("Next"))
+    _solver.run(1);
+  if (ImGui::Button("Next+10"))
+    _solver.run(10);
+  if (ImGui::Button("Next+100"))
+    _solver.run(100);
+  if (ImGui::Button("Next+1000"))
+    _solver.run(1000);
+  if (_solver.busy()) {
     if (ImGui::Button("Stop")) {
-      _playing = false;
+      _solver.cancel();
       }
     }
   else {
     if (ImGui::Button("Play")) {
-      _playing = true;
+      _solver.play(true);
       }
     }
 
-  ImGui::InputInt("Iterations per view", &_settings.iterations_per_visualization);
+  bool parameters_changed = false;
+  parameters_changed |= ImGui::Checkbox("Adaptive iterations", &_settings.adaptive_iterations);
+  if (_settings.adaptive_iterations)
+    parameters_changed |= ImGui::InputDouble("Frame budget (ms)", &_settings.frame_budget_ms);
+  else
+    parameters_changed |= ImGui::InputInt("Iterations per view", &_settings.iterations_per_visualization);
+  ImGui::InputInt("Population size", &_settings.population);
+  parameters_changed |= ImGui::InputDouble("Elitarism factor", &_settings.elitarism_factor);
+  parameters_changed |= ImGui::InputDouble("Mutation chance", &_settings.mutation_chance);
+  if (parameters_changed)
+    _update_solver_parameters();
+
+  if (ImGui::Button("Reset view"))
+    _reset_camera();
+  ImGui::Checkbox("Heatmap", &_settings.heatmap);
+
+  ImGui::Text("Generations/s: %.1f (%.2f ms per generation)", _solver.generations_per_second(), _solver.generation_ms());
 
+  ImGui::End();
+  }
 
-  if (ImGui::InputDouble("Elitarism factor", &_settings.elitarism_factor)) {
-    elitarism_factor = _settings.elitarism_factor;
+void view::_profiler_window()
+  {
+  ImGui::SetNextWindowSize(ImVec2(400, 500), ImGuiCond_FirstUseEver);
+  if (!ImGui::Begin("Profiler", &_settings.profiler_window))
+    {
+    ImGui::End();
+    return;
     }
-  if (ImGui::InputDouble("Mutation chance", &_settings.mutation_chance)) {
-    mutation_chance = _settings.mutation_chance;
+  std::vector<float> samples;
+  float means[number_of_profile_phases];
+  for (int p = 0; p < number_of_profile_phases; ++p)
+    {
+    _profiler.samples(samples, (profile_phase)p);
+    float sum = 0.f, maximum = 0.f;
+    for (float v : samples)
+      {
+      sum += v;
+      maximum = std::max(maximum, v);
+      }
+    means[p] = samples.empty() ? 0.f : sum / (float)samples.size();
+    char overlay[64];
+    snprintf(overlay, sizeof(overlay), "mean %.3f ms, max %.3f ms", means[p], maximum);
+    ImGui::PlotLines(profile_phase_name((profile_phase)p), samples.data(), (int)samples.size(), 0, overlay, 0.f, FLT_MAX, ImVec2(0, 40));
+    }
+  ImGui::Separator();
+  ImGui::PlotHistogram("mean ms", means, number_of_profile_phases, 0, "selection .. swap", 0.f, FLT_MAX, ImVec2(0, 80));
+  if (ImGui::Button("Clear"))
+    _profiler.clear();
+  ImGui::SameLine();
+  if (ImGui::Button("Dump to marslander_profile.csv"))
+    {
+    std::string error;
+    if (_profiler.dump("marslander_profile.csv", error))
+      Logging::Info() << "Wrote marslander_profile.csv\n";
+    else
+      Logging::Error() << error << "\n";
+    }
+  ImGui::Separator();
+  bool tracing = Tracing::enabled();
+  if (ImGui::Checkbox("Trace", &tracing))
+    {
+    if (tracing)
+      Tracing::start();
+    else
+      Tracing::stop();
+    }
+  ImGui::SameLine();
+  if (ImGui::Button("Save trace to marslander_trace.json"))
+    {
+    std::string error;
+    if (Tracing::dump("marslander_trace.json", error))
+      Logging::Info() << "Wrote marslander_trace.json, open it in chrome://tracing or ui.perfetto.dev\n";
+    else
+      Logging::Error() << error << "\n";
+    if (Tracing::dropped() > 0)
+      Logging::Warning() << Tracing::dropped() << " trace events were dropped\n";
     }
-
   ImGui::End();
   }
 
+void view::_drain_log()
+  {
+  Logging::drain(_log_records);
+  for (const auto& r : _log_records)
+    _log.AddLog("[%s] %.*s\n", log_level_name(r.level), (int)r.length, r.text);
+  }
+
 void view::_log_window()
   {
-  static AppLog log;
+  ImGui::SetNextWindowSize(ImVec2((float)V_W, (float)(_h - 3 * V_Y - V_H)), ImGuiCond_Always);
+  ImGui::SetNextWindowPos(ImVec2((float)V_X, (float)(2 * V_Y + V_H)), ImGuiCond_Always);
 
-  auto log_messages = Logging::GetInstance().pop_messages();
+  _log.Draw("Log window", &_settings.log_window);
+  }
 
-  if (!log_messages.empty())
-    log.AddLog("%s", log_messages.c_str());
+void view::_reset_camera()
+  {
+  _zoom = 1.f;
+  _center = vec2<float>(W * 0.5f, H * 0.5f);
+  }
 
-  ImGui::SetNextWindowSize(ImVec2((float)V_W, (float)(_h - 3 * V_Y - V_H)), ImGuiCond_Always);
-  ImGui::SetNextWindowPos(ImVec2((float)V_X, (float)(2 * V_Y + V_H)), ImGuiCond_Always);
+std::array<float, 4> view::_world_to_clip() const
+  {
+  const float sx = 2.f * _zoom / (float)W;
+  const float sy = 2.f * _zoom / (float)H;
+  return { sx, sy, -_center.x * sx, -_center.y * sy };
+  }
 
-  log.Draw("Log window", &_settings.log_window);
+vec2<float> view::_mouse_to_world(float x, float y) const
+  {
+  const float u = (x - (float)_viewport_pos_x) / (float)_viewport_w * 2.f - 1.f;
+  const float v = 1.f - (y - (float)_viewport_pos_y) / (float)_viewport_h * 2.f;
+  return vec2<float>(_center.x + u * (float)W / (2.f * _zoom), _center.y + v * (float)H / (2.f * _zoom));
   }
 
-void view::_run_simulations(int nr) {
-  for (int i = 0; i < nr; ++i) {
-    make_next_generation(_m);
-    simulate_population(_m);
-    }
-  _total_iterations += nr;
+void view::_accumulate_heatmap(const std::array<float, 4>& transform)
+  {
+  using namespace jtk;
+  glBindFramebuffer(GL_FRAMEBUFFER, _heatmap_fbo);
+  glViewport(0, 0, _viewport_w, _viewport_h);
+  glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+  glClear(GL_COLOR_BUFFER_BIT);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_ONE, GL_ONE);
+  _m._path_vao->bind();
+  _heatmap_program->bind();
+  _heatmap_program->set_uniform_value("iTransform", transform[0], transform[1], transform[2], transform[3]);
+  glMultiDrawArrays(GL_LINE_STRIP, _m.path_first.data(), _m.path_count.data(), _m.number_of_paths);
+  gl_check_error("glMultiDrawArrays");
+  _heatmap_program->release();
+  _m._path_vao->release();
+  glDisable(GL_BLEND);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  }
+
+void view::_tone_map_heatmap()
+  {
+  using namespace jtk;
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, _heatmap_texture);
+  _vao_heatmap->bind();
+  _tone_map_program->bind();
+  _tone_map_program->set_uniform_value("iChannel0", 0);
+  _tone_map_program->set_uniform_value("iMaxDensity", (GLfloat)std::max(1, _m.number_of_paths));
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+  gl_check_error("glDrawArrays");
+  _tone_map_program->release();
+  _vao_heatmap->release();
+  glBindTexture(GL_TEXTURE_2D, 0);
+  }
+
+void view::_update_solver_parameters()
+  {
+  const double frame_budget_ms = _settings.adaptive_iterations ? std::max(1.0, _settings.frame_budget_ms) : 0.0;
+  _solver.set_parameters(_settings.elitarism_factor, _settings.mutation_chance, _settings.iterations_per_visualization, frame_budget_ms);
+  }
+
+bool view::_poll_solver()
+  {
+  solver_snapshot* snap = _solver.poll();
+  if (!snap)
+    return false;
+  std::swap(_m.current_population, snap->current_population);
+  std::swap(_m.current_population_normalized_score, snap->current_population_normalized_score);
+  std::swap(_m.current_population_paths, snap->paths);
+  _total_iterations = snap->generation;
+  _prepare_render();
+  _print_best_run_results();
+  return true;
   }
 
 void view::loop()
   {
   using namespace jtk;
+  int frames_to_render = 1;
   while (!_quit)
     {
-    _poll_for_events();
-
-    if (_playing) {
-      _run_simulations(_settings.iterations_per_visualization);
-      _prepare_render();
-      _print_best_run_results();
+    // When rendering on demand, sleep in SDL_WaitEventTimeout until there is input or a new
+    // snapshot (the solver thread pushes an event for every snapshot, see the constructor).
+    const bool idle = _settings.render_on_demand && frames_to_render == 0;
+    if (_poll_for_events(idle ? 500 : 0))
+      frames_to_render = 3; // ImGui needs a few frames to settle hover and focus after input
+    if (_poll_solver())
+      frames_to_render = std::max(frames_to_render, 1);
+    if (_settings.render_on_demand)
+      {
+      if (frames_to_render == 0 && !ImGui::GetIO().WantTextInput) // keep the text cursor blinking
+        continue;
+      frames_to_render = std::max(0, frames_to_render - 1);
       }
 
+    std::chrono::steady_clock::time_point draw_start = std::chrono::steady_clock::now();
+
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    const std::array<float, 4> transform = _world_to_clip();
+    if (_settings.heatmap)
+      _accumulate_heatmap(transform);
+
     _fbo->bind(1);
     gl_check_error("_fbo->bind()");
     glViewport(0, 0, _viewport_w, _viewport_h);
     glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    if (_settings.heatmap)
+      _tone_map_heatmap();
+
     _m._vao->bind();
     gl_check_error("_vao->bind()");
     _m._vbo_array->bind();
@@ -711,16 +1111,19 @@ void view::loop()
     _program->bind();
     gl_check_error("_program->bind()");
 
-    _program->enable_attribute_array(0);
-    gl_check_error("_program->enable_attribute_array(0)");
-    _program->set_attribute_buffer(0, GL_FLOAT, 0, 2, sizeof(GLfloat) * 2); // x y
-    gl_check_error("_program->set_attribute_buffer(0, GL_FLOAT, 0, 2, sizeof(GLfloat) * 2)");
-
+    _program->set_uniform_value("iTransform", transform[0], transform[1], transform[2], transform[3]);
     _program->set_uniform_value("iColor", (GLfloat)1, (GLfloat)0, (GLfloat)0, (GLfloat)1);
 
     glDrawArrays(GL_LINE_STRIP, 0, (GLsizei)(_m.number_of_terrain_points));
     gl_check_error("glDrawArrays");
 
+    if (_settings.heatmap)
+      {
+      _program->set_uniform_value("iColor", (GLfloat)1, (GLfloat)1, (GLfloat)0, (GLfloat)1);
+      glDrawArrays(GL_LINES, _m.landing_zone_first, 2);
+      gl_check_error("glDrawArrays");
+      }
+
     _program->release();
     gl_check_error("_program->release()");
     _m._vbo_array->release();
@@ -728,48 +1131,21 @@ void view::loop()
     _m._vao->release();
     gl_check_error("_m._vao->release()");
 
-    int best_index = 0;
-    double best_score = 0.0;
-    for (int i = 0; i <= _m._path_vao.size(); ++i) {
-      bool last_draw = false;
-      if (i == _m._path_vao.size()) {
-        i = best_index;
-        last_draw = true;
-        }
-      _m._path_vao[i]->bind();
-      gl_check_error("_path_vao[i]->bind()");
-      _m._path_vbo_array[i]->bind();
-      gl_check_error("_path_vbo_array[i]->bind()");
-
-      _program->bind();
-      gl_check_error("_program->bind()");
-
-      _program->enable_attribute_array(0);
-      gl_check_error("_program->enable_attribute_array(0)");
-      _program->set_attribute_buffer(0, GL_FLOAT, 0, 2, sizeof(GLfloat) * 2); // x y
-      gl_check_error("_program->set_attribute_buffer(0, GL_FLOAT, 0, 2, sizeof(GLfloat) * 2)");
-      double s = _m.current_population_normalized_score[i];
-      if (s > best_score) {
-        best_score = s;
-        best_index = i;
-        }
-      if (last_draw)
-        _program->set_uniform_value("iColor", (GLfloat)0, (GLfloat)1, (GLfloat)0, (GLfloat)1);
-      else
-        _program->set_uniform_value("iColor", (GLfloat)s * 0.75f, (GLfloat)s * 0.75f, (GLfloat)0.75f, (GLfloat)1.f);
-
-      glDrawArrays(GL_LINE_STRIP, 0, (GLsizei)(_m.current_population.front().size()));
-      gl_check_error("glDrawArrays");
-
-      _program->release();
-      gl_check_error("_program->release()");
-      _m._path_vbo_array[i]->release();
-      gl_check_error("_m._path_vbo_array[i]->release()");
-      _m._path_vao[i]->release();
-      gl_check_error("_m._path_vao[i]->release()");
-      if (last_draw)
-        break;
+    _m._path_vao->bind();
+    if (!_settings.heatmap)
+      {
+      _path_program->bind();
+      _path_program->set_uniform_value("iTransform", transform[0], transform[1], transform[2], transform[3]);
+      glMultiDrawArrays(GL_LINE_STRIP, _m.path_first.data(), _m.path_count.data(), _m.number_of_paths);
+      _path_program->release();
       }
+    // highlight pass for the best path
+    _program->bind();
+    _program->set_uniform_value("iColor", (GLfloat)0, (GLfloat)1, (GLfloat)0, (GLfloat)1);
+    glDrawArrays(GL_LINE_STRIP, _m.best_path * chromosome_size, chromosome_size);
+    gl_check_error("glDrawArrays");
+    _program->release();
+    _m._path_vao->release();
 
     _fbo->release();
     gl_check_error("_fbo->release()");
@@ -808,13 +1184,21 @@ void view::loop()
 
     _vao_blit->release();
     _fbo->get_texture()->release();
+    _profiler.add(phase_draw, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - draw_start).count());
 
-    _imgui_ui();
-
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-
+      {
+      scoped_timer t(&_profiler, phase_ui);
+      trace_scope trace("ui");
+      _imgui_ui();
+      ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+      }
 
-    SDL_GL_SwapWindow(_window);
+      {
+      // includes waiting for vsync, and for the gpu to finish the frame
+      scoped_timer t(&_profiler, phase_swap);
+      trace_scope trace("swap");
+      SDL_GL_SwapWindow(_window);
+      }
 
     glGetError(); //hack
     }
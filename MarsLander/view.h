@@ -9,6 +9,10 @@
 #include "settings.h"
 #include "model.h"
 #include "mouse_data.h"
+#include "solver_thread.h"
+#include "logging.h"
+#include "metrics.h"
+#include "checkpoint.h"
 
 namespace jtk
   {
@@ -29,18 +33,30 @@ class view
     void loop();
 
   private:
-    void _poll_for_events();
+    bool _poll_for_events(int wait_ms); // returns true if an event was handled
     void _imgui_ui();
     void _setup_blit_gl_objects(bool fullscreen);
     void _setup_gl_objects();
     void _log_window();
+    void _drain_log();
     void _control_window();
     void _script_window();
+    void _profiler_window();
     void _destroy_gl_objects();
     void _destroy_blit_gl_objects();
+    void _setup_heatmap_gl_objects();
+    void _destroy_heatmap_gl_objects();
+    void _accumulate_heatmap(const std::array<float, 4>& transform);
+    void _tone_map_heatmap();
+    void _restart();
+    void _resume(const checkpoint& c);
     void _prepare_render();
     void _print_best_run_results();
-    void _run_simulations(int nr);
+    bool _poll_solver(); // returns true if a new snapshot was taken
+    void _update_solver_parameters();
+    void _reset_camera();
+    std::array<float, 4> _world_to_clip() const; // scale and offset for the iTransform uniform
+    vec2<float> _mouse_to_world(float x, float y) const;
 
   private:
     SDL_Window* _window;    
@@ -52,10 +68,23 @@ class view
     jtk::buffer_object* _vbo_index_blit;
     jtk::vertex_array_object* _vao_blit;
     jtk::shader_program* _program;   
+    jtk::shader_program* _path_program;
     jtk::shader_program* _program_blit;
+    jtk::shader_program* _heatmap_program;
+    jtk::shader_program* _tone_map_program;
+    jtk::vertex_array_object* _vao_heatmap; // empty, the tone map pass generates its triangle
+    GLuint _heatmap_fbo, _heatmap_texture; // single channel float density, viewport sized
     mouse_data _md;
     model _m;
     std::string _script;
-    bool _playing;
     int _total_iterations;
+    float _zoom;
+    vec2<float> _center; // world coordinates at the center of the viewport
+    solver_thread _solver;
+    profiler _profiler;
+    metrics_writer _metrics;
+    checkpoint_writer _checkpoints;
+    trajectory_publisher _publisher;
+    AppLog _log;
+    std::vector<log_record> _log_records;
   };
@@ -0,0 +1,245 @@
+#include "convergence.h"
+
+#include "cgalgo.h"
+#include "solver.h"
+
+#include <json.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <thread>
+
+namespace
+  {
+  struct run_result
+    {
+    int seed;
+    bool landed;
+    int generations;
+    double milliseconds;
+    };
+
+  struct level_summary
+    {
+    std::string level;
+    int runs;
+    int failures;
+    double generations[3]; // median, p90, p99, infinity if the percentile is a failure
+    double milliseconds[3];
+    };
+
+  const double percentiles[3] = { 0.5, 0.9, 0.99 };
+  const char* percentile_names[3] = { "median", "p90", "p99" };
+
+  // Nearest rank percentile, failures are sorted last as infinity.
+  double percentile(std::vector<double> values, double p)
+    {
+    std::sort(values.begin(), values.end());
+    size_t rank = (size_t)std::ceil(p * (double)values.size());
+    rank = std::max<size_t>(1, std::min(rank, values.size()));
+    return values[rank - 1];
+    }
+
+  level_summary summarize(const std::string& level, const std::vector<run_result>& runs)
+    {
+    level_summary sum;
+    sum.level = level;
+    sum.runs = (int)runs.size();
+    sum.failures = 0;
+    std::vector<double> gens, ms;
+    for (const auto& r : runs)
+      {
+      if (!r.landed)
+        ++sum.failures;
+      gens.push_back(r.landed ? (double)r.generations : std::numeric_limits<double>::infinity());
+      ms.push_back(r.landed ? r.milliseconds : std::numeric_limits<double>::infinity());
+      }
+    for (int i = 0; i < 3; ++i)
+      {
+      sum.generations[i] = percentile(gens, percentiles[i]);
+      sum.milliseconds[i] = percentile(ms, percentiles[i]);
+      }
+    return sum;
+    }
+
+  std::string format_value(double v, int precision)
+    {
+    if (std::isinf(v))
+      return "fail";
+    std::stringstream str;
+    str << std::fixed << std::setprecision(precision) << v;
+    return str.str();
+    }
+
+  nlohmann::json to_json(double v)
+    {
+    if (std::isinf(v))
+      return nullptr;
+    return v;
+    }
+
+  double from_json(const nlohmann::json& j)
+    {
+    if (j.is_null())
+      return std::numeric_limits<double>::infinity();
+    return j.get<double>();
+    }
+
+  std::vector<run_result> solve_level(const convergence_settings& s)
+    {
+    std::vector<run_result> results(s.seeds);
+    std::atomic<int> next_seed(0);
+    auto worker = [&]()
+      {
+      for (int i = next_seed++; i < s.seeds; i = next_seed++)
+        {
+        auto tic = std::chrono::steady_clock::now();
+        seed_random(i + 1);
+        solver sol;
+        sol.engine = s.engine;
+        sol.beam.width = s.beam_width;
+        sol.macro.hold = s.hold;
+        init_solver(sol, s.population);
+        run_result& r = results[i];
+        r.seed = i + 1;
+        r.landed = solve(sol, s.max_generations);
+        r.generations = sol.generation;
+        auto toc = std::chrono::steady_clock::now();
+        r.milliseconds = (double)std::chrono::duration_cast<std::chrono::microseconds>(toc - tic).count() / 1000.0;
+        }
+      };
+    std::vector<std::thread> threads;
+    for (int t = 1; t < s.jobs; ++t)
+      threads.emplace_back(worker);
+    worker();
+    for (auto& t : threads)
+      t.join();
+    return results;
+    }
+
+  void print_summary(const level_summary& sum)
+    {
+    std::cout << std::left << std::setw(28) << sum.level << std::right
+      << std::setw(6) << sum.runs
+      << std::setw(8) << std::fixed << std::setprecision(1) << 100.0 * sum.failures / sum.runs << "%";
+    for (int i = 0; i < 3; ++i)
+      std::cout << std::setw(10) << format_value(sum.generations[i], 0);
+    for (int i = 0; i < 3; ++i)
+      std::cout << std::setw(11) << format_value(sum.milliseconds[i], 1);
+    std::cout << "\n";
+    }
+
+  void write_json(const convergence_settings& s, const std::vector<level_summary>& summaries, const std::vector<std::vector<run_result>>& all_runs)
+    {
+    nlohmann::json j;
+    j["elitarism_factor"] = s.elitarism_factor;
+    j["mutation_chance"] = s.mutation_chance;
+    j["population"] = s.population;
+    j["engine"] = engine_name(s.engine);
+    if (s.engine == engine_beam)
+      j["beam_width"] = s.beam_width;
+    if (s.engine == engine_macro)
+      j["hold"] = s.hold;
+    j["max_generations"] = s.max_generations;
+    j["seeds"] = s.seeds;
+    nlohmann::json levels = nlohmann::json::array();
+    for (size_t l = 0; l < summaries.size(); ++l)
+      {
+      const auto& sum = summaries[l];
+      nlohmann::json lj;
+      lj["level"] = sum.level;
+      lj["runs"] = sum.runs;
+      lj["failures"] = sum.failures;
+      for (int i = 0; i < 3; ++i)
+        {
+        lj["generations"][percentile_names[i]] = to_json(sum.generations[i]);
+        lj["milliseconds"][percentile_names[i]] = to_json(sum.milliseconds[i]);
+        }
+      nlohmann::json runs = nlohmann::json::array();
+      for (const auto& r : all_runs[l])
+        runs.push_back({ r.seed, r.landed, r.generations, r.milliseconds });
+      lj["runs_seed_landed_generations_ms"] = runs;
+      levels.push_back(lj);
+      }
+    j["levels"] = levels;
+    std::ofstream f(s.json_output);
+    f << j.dump(1) << "\n";
+    }
+
+  void compare(const convergence_settings& s, const std::vector<level_summary>& summaries)
+    {
+    std::ifstream f(s.compare);
+    if (!f.is_open())
+      {
+      std::cerr << "cannot open " << s.compare << "\n";
+      return;
+      }
+    nlohmann::json j;
+    f >> j;
+    std::cout << std::defaultfloat << "\nComparison with " << s.compare << " (elitarism " << j["elitarism_factor"].get<double>() << ", mutation " << j["mutation_chance"].get<double>() << "), this run / other run:\n";
+    std::map<std::string, nlohmann::json> other;
+    for (const auto& lj : j["levels"])
+      other[lj["level"].get<std::string>()] = lj;
+    for (const auto& sum : summaries)
+      {
+      auto it = other.find(sum.level);
+      if (it == other.end())
+        continue;
+      const auto& lj = it->second;
+      std::cout << std::left << std::setw(28) << sum.level << std::right << "  failures "
+        << std::fixed << std::setprecision(1) << 100.0 * sum.failures / sum.runs << "% / "
+        << 100.0 * lj["failures"].get<int>() / lj["runs"].get<int>() << "%";
+      for (int i = 0; i < 3; ++i)
+        std::cout << "  " << percentile_names[i] << " ms " << format_value(sum.milliseconds[i], 1) << " / " << format_value(from_json(lj["milliseconds"][percentile_names[i]]), 1);
+      std::cout << "\n";
+      }
+    }
+  }
+
+int run_convergence(const convergence_settings& s)
+  {
+  elitarism_factor = s.elitarism_factor;
+  mutation_chance = s.mutation_chance;
+  number_of_threads = 1; // the runs themselves are spread over the threads
+
+  std::cout << engine_name(s.engine) << " engine";
+  if (s.engine == engine_beam)
+    std::cout << " of width " << s.beam_width;
+  if (s.engine == engine_macro)
+    std::cout << " holding genes for " << s.hold << " steps";
+  std::cout << ", elitarism factor " << s.elitarism_factor << ", mutation chance " << s.mutation_chance << ", population " << s.population
+    << ", " << s.seeds << " seeds, at most " << s.max_generations << " generations, " << s.jobs << " jobs\n";
+  std::cout << std::left << std::setw(28) << "level" << std::right << std::setw(6) << "runs" << std::setw(9) << "failed"
+    << std::setw(10) << "gen p50" << std::setw(10) << "gen p90" << std::setw(10) << "gen p99"
+    << std::setw(11) << "ms p50" << std::setw(11) << "ms p90" << std::setw(11) << "ms p99" << "\n";
+
+  std::vector<level_summary> summaries;
+  std::vector<std::vector<run_result>> all_runs;
+  for (const auto& filename : s.levels)
+    {
+    std::ifstream t(filename);
+    std::string str((std::istreambuf_iterator<char>(t)), std::istreambuf_iterator<char>());
+    std::string error;
+    if (!read_input(str, error))
+      {
+      std::cerr << filename << ": " << error << "\n";
+      continue;
+      }
+    all_runs.push_back(solve_level(s));
+    summaries.push_back(summarize(std::filesystem::path(filename).stem().string(), all_runs.back()));
+    print_summary(summaries.back());
+    }
+
+  if (!s.json_output.empty())
+    write_json(s, summaries, all_runs);
+  if (!s.compare.empty())
+    compare(s, summaries);
+  return 0;
+  }
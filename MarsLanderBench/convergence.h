@@ -0,0 +1,29 @@
+#pragma once
+
+#include "solver.h"
+
+#include <string>
+#include <vector>
+
+struct convergence_settings
+  {
+  std::vector<std::string> levels;
+  int seeds; // runs per level, with seeds 1..seeds
+  int max_generations; // a run that does not land within this many generations is a failure
+  int population;
+  solver_engine engine;
+  int beam_width;
+  int hold; // steps per gene of the macro engine
+  int jobs; // runs solved in parallel
+  double elitarism_factor;
+  double mutation_chance;
+  std::string json_output;
+  std::string compare; // json file of an earlier convergence run
+  };
+
+/*
+ Solves every level once per seed and reports the distribution of the generations and wall time
+ until the best chromosome first makes a valid landing.
+ Returns the process exit code.
+ */
+int run_convergence(const convergence_settings& s);
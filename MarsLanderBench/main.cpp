@@ -0,0 +1,377 @@
+/*
+ Microbenchmarks for the hot paths of the solver.
+
+ Every benchmark is run for each level, population size and thread count given on the command line.
+ Results can be written as json, and compared against an earlier json file to gate changes.
+
+ With --convergence the time to a first valid landing is measured over many seeds instead.
+ */
+
+#include "cgalgo.h"
+#include "convergence.h"
+
+#include <json.hpp>
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+#include <sstream>
+#include <thread>
+
+namespace
+  {
+  struct bench_settings
+    {
+    std::vector<std::string> levels;
+    std::vector<int> population_sizes;
+    std::vector<int> thread_counts;
+    double min_time; // seconds per benchmark
+    std::string json_output;
+    std::string baseline;
+    double tolerance; // relative slow down that counts as a regression
+    };
+
+  struct bench_result
+    {
+    std::string name;
+    double ns_per_op;
+    double rate; // ops per second, where an op is a unit
+    std::string unit;
+    };
+
+  void print_usage()
+    {
+    std::cout << "Usage: MarsLanderBench [level.txt|folder]... [-p <population sizes>] [-t <thread counts>] [--min-time <seconds>]\n";
+    std::cout << "                       [--json <output.json>] [--baseline <baseline.json>] [--tolerance <fraction>]\n";
+    std::cout << "  Population sizes and thread counts are comma separated lists, e.g. -p 200,2000 -t 1,4.\n";
+    std::cout << "  With --baseline the exit code is 2 if any benchmark is slower than the baseline by more than the tolerance.\n";
+    std::cout << "Usage: MarsLanderBench --convergence [level.txt|folder]... [--seeds <n>] [-g <max generations>] [-p <population size>]\n";
+    std::cout << "                       [-j <jobs>] [--elitarism <factor>] [--mutation <chance>] [--engine genetic|beam|differential|macro] [--beam-width <n>]\n";
+    std::cout << "                       [--json <output.json>] [--compare <other.json>]\n";
+    std::cout << "  Reports the failure rate and the median, p90 and p99 generations and wall time until a first valid landing.\n";
+    }
+
+  std::vector<int> parse_list(const char* s)
+    {
+    std::vector<int> out;
+    std::stringstream str(s);
+    std::string item;
+    while (std::getline(str, item, ','))
+      out.push_back(atoi(item.c_str()));
+    return out;
+    }
+
+  /*
+   Calls fun repeatedly, doubling the number of calls until min_time is reached.
+   Returns the number of nanoseconds per call.
+   */
+  template <class TFunctor>
+  double measure(TFunctor fun, double min_time)
+    {
+    int64_t calls = 1;
+    for (;;)
+      {
+      auto tic = std::chrono::steady_clock::now();
+      for (int64_t i = 0; i < calls; ++i)
+        fun();
+      auto toc = std::chrono::steady_clock::now();
+      const double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(toc - tic).count();
+      if (ns >= min_time * 1e9)
+        return ns / (double)calls;
+      calls *= 2;
+      }
+    }
+
+  // Counts the simulation steps evaluate takes for c, i.e. until the lander hits the surface.
+  int count_steps(const chromosome& c)
+    {
+    simulation_data sd = simdata;
+    int PX = (int)std::round(sd.p[0]);
+    int PY = (int)std::round(sd.p[1]);
+    int angle = sd.R;
+    int thrust = sd.P;
+    for (int i = 0; i < chromosome_size; ++i)
+      {
+      angle = std::max(-maximum_angle, std::min(maximum_angle, angle + c[i].angle));
+      thrust = std::max(0, std::min(maximum_thrust, thrust + c[i].thrust));
+      simulate(sd, angle, thrust);
+      int X = (int)std::round(sd.p[0]);
+      int Y = (int)std::round(sd.p[1]);
+      if (crashed_or_landed(X, Y, PX, PY))
+        return i + 1;
+      PX = X;
+      PY = Y;
+      }
+    return chromosome_size;
+    }
+
+  void add_result(std::vector<bench_result>& results, const std::string& name, double ns_per_op, const std::string& unit)
+    {
+    bench_result r;
+    r.name = name;
+    r.ns_per_op = ns_per_op;
+    r.rate = 1e9 / ns_per_op;
+    r.unit = unit;
+    results.push_back(r);
+    std::cout << std::left << std::setw(64) << name << std::right << std::setw(14) << std::fixed << std::setprecision(1) << ns_per_op << " ns" << std::setw(16) << std::setprecision(0) << r.rate << " " << unit << "/s\n";
+    }
+
+  void run_level_benchmarks(std::vector<bench_result>& results, const std::string& level_name, const bench_settings& s)
+    {
+    // per step physics, independent of population size and threads
+    population pop = generate_random_population(population_size);
+    int64_t total_steps = 0;
+    for (const auto& c : pop)
+      total_steps += count_steps(c);
+    const double average_steps = (double)total_steps / (double)pop.size();
+
+    int gene_index = 0;
+    simulation_data sd = simdata;
+    double ns = measure([&]()
+      {
+      const gene& g = pop[0][gene_index];
+      simulate(sd, sd.R + g.angle, sd.P + g.thrust);
+      if (++gene_index == chromosome_size)
+        {
+        gene_index = 0;
+        sd = simdata;
+        }
+      }, s.min_time);
+    add_result(results, "simulate/" + level_name, ns, "steps");
+
+    // collision test of every path segment of a population against the surface
+    std::vector<std::vector<vec2<int16_t>>> paths(pop.size(), std::vector<vec2<int16_t>>(chromosome_size));
+    for (size_t i = 0; i < pop.size(); ++i)
+      evaluate(paths[i].data(), pop[i]);
+    size_t path_index = 0;
+    int segment_index = 1;
+    volatile bool sink = false;
+    ns = measure([&]()
+      {
+      const auto& p = paths[path_index];
+      sink = crashed_or_landed((int)p[segment_index].x, (int)p[segment_index].y, (int)p[segment_index - 1].x, (int)p[segment_index - 1].y);
+      if (++segment_index == (int)p.size())
+        {
+        segment_index = 1;
+        path_index = (path_index + 1) % paths.size();
+        }
+      }, s.min_time);
+    add_result(results, "crashed_or_landed/" + level_name + "/" + std::to_string(surface_points.size()) + "pts", ns, "calls");
+
+    size_t chromosome_index = 0;
+    ns = measure([&]()
+      {
+      evaluate(nullptr, pop[chromosome_index]);
+      chromosome_index = (chromosome_index + 1) % pop.size();
+      }, s.min_time);
+    add_result(results, "evaluate/" + level_name, ns, "evals");
+    add_result(results, "evaluate_per_step/" + level_name, ns / average_steps, "steps");
+
+    for (int size : s.population_sizes)
+      {
+      const std::string suffix = "/" + level_name + "/p" + std::to_string(size);
+      population current = generate_random_population(size);
+      population next;
+      std::vector<int64_t> scores;
+      std::vector<double> normalized;
+      number_of_threads = 1;
+      evaluate_population(scores, current);
+
+      ns = measure([&]()
+        {
+        normalize_scores_roulette_wheel(normalized, scores);
+        }, s.min_time);
+      add_result(results, "normalize_scores_roulette_wheel" + suffix, ns, "calls");
+
+      ns = measure([&]()
+        {
+        make_next_generation(next, current, normalized);
+        }, s.min_time);
+      add_result(results, "make_next_generation" + suffix, ns, "calls");
+
+      for (int threads : s.thread_counts)
+        {
+        number_of_threads = threads;
+        const std::string thread_suffix = suffix + "/t" + std::to_string(threads);
+        ns = measure([&]()
+          {
+          evaluate_population(scores, current);
+          }, s.min_time);
+        add_result(results, "evaluate_population" + thread_suffix, ns / (double)size, "evals");
+
+        ns = measure([&]()
+          {
+          make_next_generation(next, current, normalized);
+          std::swap(current, next);
+          evaluate_population(scores, current);
+          normalize_scores_roulette_wheel(normalized, scores);
+          }, s.min_time);
+        add_result(results, "generation" + thread_suffix, ns, "gens");
+        }
+      }
+    }
+
+  void write_json(const std::vector<bench_result>& results, const bench_settings& s)
+    {
+    nlohmann::json j;
+    j["chromosome_size"] = chromosome_size;
+    j["min_time"] = s.min_time;
+    nlohmann::json arr = nlohmann::json::array();
+    for (const auto& r : results)
+      {
+      nlohmann::json b;
+      b["name"] = r.name;
+      b["ns_per_op"] = r.ns_per_op;
+      b["rate"] = r.rate;
+      b["unit"] = r.unit;
+      arr.push_back(b);
+      }
+    j["benchmarks"] = arr;
+    std::ofstream f(s.json_output);
+    f << j.dump(2) << "\n";
+    }
+
+  // Returns false if any benchmark regressed by more than the tolerance.
+  bool compare_with_baseline(const std::vector<bench_result>& results, const bench_settings& s)
+    {
+    std::ifstream f(s.baseline);
+    if (!f.is_open())
+      {
+      std::cerr << "cannot open baseline " << s.baseline << "\n";
+      return false;
+      }
+    nlohmann::json j;
+    f >> j;
+    std::map<std::string, double> baseline;
+    for (const auto& b : j["benchmarks"])
+      baseline[b["name"].get<std::string>()] = b["ns_per_op"].get<double>();
+    bool ok = true;
+    std::cout << "\nComparison with " << s.baseline << " (positive is slower):\n";
+    for (const auto& r : results)
+      {
+      auto it = baseline.find(r.name);
+      if (it == baseline.end())
+        continue;
+      const double change = r.ns_per_op / it->second - 1.0;
+      const bool regression = change > s.tolerance;
+      if (regression)
+        ok = false;
+      std::cout << std::left << std::setw(64) << r.name << std::right << std::setw(9) << std::showpos << std::setprecision(1) << change * 100.0 << std::noshowpos << "%" << (regression ? "  REGRESSION" : "") << "\n";
+      }
+    return ok;
+    }
+  }
+
+int main(int argc, char** argv)
+  {
+  bench_settings s;
+  s.population_sizes = { population_size };
+  s.thread_counts = { 1, (int)std::max(1u, std::thread::hardware_concurrency()) };
+  s.min_time = 0.2;
+  s.tolerance = 0.05;
+  bool convergence = false;
+  convergence_settings cs;
+  cs.seeds = 100;
+  cs.max_generations = 1000;
+  cs.jobs = (int)std::max(1u, std::thread::hardware_concurrency());
+  cs.elitarism_factor = elitarism_factor;
+  cs.mutation_chance = mutation_chance;
+  cs.engine = engine_genetic;
+  cs.beam_width = beam_search().width;
+  cs.hold = macro_search().hold;
+  for (int i = 1; i < argc; ++i)
+    {
+    if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0)
+      {
+      print_usage();
+      return 0;
+      }
+    if (i + 1 < argc && strcmp(argv[i], "-p") == 0)
+      s.population_sizes = parse_list(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "-t") == 0)
+      s.thread_counts = parse_list(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "--min-time") == 0)
+      s.min_time = atof(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "--json") == 0)
+      s.json_output = argv[++i];
+    else if (i + 1 < argc && strcmp(argv[i], "--baseline") == 0)
+      s.baseline = argv[++i];
+    else if (i + 1 < argc && strcmp(argv[i], "--tolerance") == 0)
+      s.tolerance = atof(argv[++i]);
+    else if (strcmp(argv[i], "--convergence") == 0)
+      convergence = true;
+    else if (i + 1 < argc && strcmp(argv[i], "--seeds") == 0)
+      cs.seeds = atoi(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "-g") == 0)
+      cs.max_generations = atoi(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "-j") == 0)
+      cs.jobs = std::max(1, atoi(argv[++i]));
+    else if (i + 1 < argc && strcmp(argv[i], "--elitarism") == 0)
+      cs.elitarism_factor = atof(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "--mutation") == 0)
+      cs.mutation_chance = atof(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "--compare") == 0)
+      cs.compare = argv[++i];
+    else if (i + 1 < argc && strcmp(argv[i], "--engine") == 0)
+      {
+      if (!parse_engine(cs.engine, argv[++i]))
+        {
+        std::cerr << "unknown engine " << argv[i] << "\n";
+        return 1;
+        }
+      }
+    else if (i + 1 < argc && strcmp(argv[i], "--beam-width") == 0)
+      cs.beam_width = std::max(1, atoi(argv[++i]));
+    else if (i + 1 < argc && strcmp(argv[i], "--hold") == 0)
+      cs.hold = std::max(1, atoi(argv[++i]));
+    else if (std::filesystem::is_directory(argv[i]))
+      {
+      for (const auto& entry : std::filesystem::directory_iterator(argv[i]))
+        if (entry.path().extension() == ".txt")
+          s.levels.push_back(entry.path().string());
+      }
+    else
+      s.levels.push_back(argv[i]);
+    }
+  if (s.levels.empty())
+    {
+    print_usage();
+    return 1;
+    }
+  std::sort(s.levels.begin(), s.levels.end());
+
+  if (convergence)
+    {
+    cs.levels = s.levels;
+    cs.population = s.population_sizes.front();
+    cs.json_output = s.json_output;
+    return run_convergence(cs);
+    }
+
+  std::vector<bench_result> results;
+  for (const auto& filename : s.levels)
+    {
+    std::ifstream t(filename);
+    std::string str((std::istreambuf_iterator<char>(t)), std::istreambuf_iterator<char>());
+    std::string error;
+    if (!read_input(str, error))
+      {
+      std::cerr << filename << ": " << error << "\n";
+      continue;
+      }
+    run_level_benchmarks(results, std::filesystem::path(filename).stem().string(), s);
+    }
+
+  if (!s.json_output.empty())
+    write_json(results, s);
+  if (!s.baseline.empty() && !compare_with_baseline(results, s))
+    return 2;
+  return 0;
+  }
@@ -0,0 +1,589 @@
+#include "cgalgo.h"
+#include "checkpoint.h"
+#include "corpus.h"
+#include "generator.h"
+#include "metrics.h"
+#include "publisher.h"
+#include "run_manifest.h"
+#include "solver.h"
+#include "trace.h"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <filesystem>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <thread>
+
+namespace
+  {
+  void print_usage()
+    {
+    std::cout << "Usage:\n";
+    std::cout << "  MarsLanderCli convert <corpus.mlc> <level.txt|folder> ...\n";
+    std::cout << "      Packs text levels into a binary level corpus.\n";
+    std::cout << "  MarsLanderCli solve <level.txt|corpus.mlc> [-g <max generations>] [-p <population size>] [--solver-seed <n>]\n";
+    std::cout << "                      [--metrics <file.csv|file.jsonl>] [--trace <file.json>] [--manifest <file.jsonl>]\n";
+    std::cout << "                      [--checkpoint <file.ckpt>] [--checkpoint-every <generations>] [--publish <name>]\n";
+    std::cout << "                      [--engine genetic|beam|differential|macro] [--beam-width <nodes>] [--hold <steps>]\n";
+    std::cout << "      Runs the solver on every level until a valid landing is found.\n";
+    std::cout << "  MarsLanderCli generate <corpus.mlc|folder|--solve> [-n <levels>] [-s <seed>] [--points <n>] [--overhangs <n>]\n";
+    std::cout << "                         [--caves <n>] [--lz-width <meters>] [--speed <m/s>] [-g <max generations>] [-p <population size>]\n";
+    std::cout << "                         [--solver-seed <n>] [--metrics <file.csv|file.jsonl>] [--trace <file.json>] [--manifest <file.jsonl>]\n";
+    std::cout << "                         [--checkpoint <file.ckpt>] [--checkpoint-every <generations>] [--publish <name>]\n";
+    std::cout << "                         [--engine genetic|beam|differential|macro] [--beam-width <nodes>] [--hold <steps>]\n";
+    std::cout << "      Generates random levels into a corpus or a folder of text levels, or streams them into the solver.\n";
+    std::cout << "  MarsLanderCli replay <manifest.jsonl>\n";
+    std::cout << "      Solves the runs of a manifest again and verifies the best score of every generation.\n";
+    std::cout << "      The exit code is 2 if a run does not reproduce.\n";
+    std::cout << "  MarsLanderCli resume <file.ckpt> [-g <max generations>] [--metrics <file.csv|file.jsonl>] [--trace <file.json>]\n";
+    std::cout << "                       [--checkpoint <file.ckpt>] [--checkpoint-every <generations>] [--publish <name>]\n";
+    std::cout << "      Continues the search of a checkpoint until a valid landing is found.\n";
+    std::cout << "  MarsLanderCli monitor <name> [-n <publications>] [--interval <ms>]\n";
+    std::cout << "      Prints the best trajectory that a solver started with --publish <name> publishes.\n";
+    std::cout << "  --solver-seed seeds the random generator of the solver for every level, the default is 73.\n";
+    std::cout << "  --metrics writes one record per generation, the run column is the index of the level.\n";
+    std::cout << "  --trace writes a timeline of the solver phases for chrome://tracing or ui.perfetto.dev.\n";
+    std::cout << "  --manifest writes one line per level with everything needed to replay the run.\n";
+    std::cout << "  --checkpoint saves the search every 1000 generations, or --checkpoint-every, and when a level ends.\n";
+    std::cout << "    The file holds the most recent checkpoint only.\n";
+    std::cout << "  --publish shares the best trajectory of the running generation in shared memory, see monitor.\n";
+    std::cout << "  --engine beam replaces the genetic algorithm by a beam search of 1000 nodes per step, or --beam-width.\n";
+    std::cout << "    A generation is one step of the beam.\n";
+    std::cout << "  --engine differential replaces it by differential evolution of the genes relaxed to real numbers.\n";
+    std::cout << "  --engine macro runs the genetic algorithm on genes that hold for 25 steps, or --hold.\n";
+    std::cout << "  Checkpoints are only written for the genetic algorithm.\n";
+    }
+
+  // Returns the value following option name in argv[first..argc), or default_value if the option is absent.
+  int get_option(int argc, char** argv, int first, const char* name, int default_value)
+    {
+    for (int i = first; i + 1 < argc; ++i)
+      {
+      if (strcmp(argv[i], name) == 0)
+        return atoi(argv[i + 1]);
+      }
+    return default_value;
+    }
+
+  const char* get_string_option(int argc, char** argv, int first, const char* name, const char* default_value)
+    {
+    for (int i = first; i + 1 < argc; ++i)
+      {
+      if (strcmp(argv[i], name) == 0)
+        return argv[i + 1];
+      }
+    return default_value;
+    }
+
+  // Opens the file of the --metrics option if present. Returns false on error.
+  bool open_metrics(metrics_writer& metrics, int argc, char** argv, int first)
+    {
+    const char* filename = get_string_option(argc, argv, first, "--metrics", nullptr);
+    if (!filename)
+      return true;
+    std::string error;
+    if (!metrics.open(filename, error))
+      {
+      std::cerr << error << "\n";
+      return false;
+      }
+    return true;
+    }
+
+  // Starts tracing if the --trace option is present and returns its file name, or null.
+  const char* start_trace(int argc, char** argv, int first)
+    {
+    const char* filename = get_string_option(argc, argv, first, "--trace", nullptr);
+    if (filename)
+      {
+      Tracing::set_thread_name("main");
+      Tracing::start();
+      }
+    return filename;
+    }
+
+  void write_trace(const char* filename)
+    {
+    if (!filename)
+      return;
+    Tracing::stop();
+    std::string error;
+    if (!Tracing::dump(filename, error))
+      std::cerr << error << "\n";
+    else if (Tracing::dropped() > 0)
+      std::cerr << Tracing::dropped() << " trace events were dropped\n";
+    }
+
+  // The options shared by solve and generate --solve.
+  struct solve_options
+    {
+    int max_generations;
+    int size;
+    int seed;
+    solver_engine engine;
+    int beam_width;
+    int hold;
+    metrics_writer metrics;
+    std::ofstream manifest;
+    checkpoint_writer checkpoints;
+    int checkpoint_interval;
+    trajectory_publisher publisher;
+    const char* trace_filename;
+    };
+
+  // Reads the options and opens their files. Returns false on error.
+  bool open_solve_options(solve_options& o, int argc, char** argv, int first)
+    {
+    o.max_generations = get_option(argc, argv, first, "-g", 1000);
+    o.size = std::max(1, get_option(argc, argv, first, "-p", population_size));
+    o.seed = get_option(argc, argv, first, "--solver-seed", 73);
+    o.engine = engine_genetic;
+    const char* engine = get_string_option(argc, argv, first, "--engine", "genetic");
+    if (!parse_engine(o.engine, engine))
+      {
+      std::cerr << "unknown engine " << engine << "\n";
+      return false;
+      }
+    o.beam_width = std::max(1, get_option(argc, argv, first, "--beam-width", beam_search().width));
+    o.hold = std::max(1, get_option(argc, argv, first, "--hold", macro_search().hold));
+    if (!open_metrics(o.metrics, argc, argv, first))
+      return false;
+    const char* manifest_filename = get_string_option(argc, argv, first, "--manifest", nullptr);
+    if (manifest_filename)
+      {
+      o.manifest.open(manifest_filename);
+      if (!o.manifest.is_open())
+        {
+        std::cerr << "cannot create " << manifest_filename << "\n";
+        return false;
+        }
+      }
+    const char* checkpoint_filename = get_string_option(argc, argv, first, "--checkpoint", nullptr);
+    if (checkpoint_filename && o.engine != engine_genetic)
+      std::cerr << "checkpoints are only written for the genetic algorithm, --checkpoint is ignored\n";
+    else if (checkpoint_filename)
+      o.checkpoints.open(checkpoint_filename);
+    o.checkpoint_interval = std::max(1, get_option(argc, argv, first, "--checkpoint-every", 1000));
+    const char* publication_name = get_string_option(argc, argv, first, "--publish", nullptr);
+    std::string error;
+    if (publication_name && !o.publisher.open(publication_name, error))
+      {
+      std::cerr << error << "\n";
+      return false;
+      }
+    o.trace_filename = start_trace(argc, argv, first);
+    return true;
+    }
+
+  // Lets s report to the files of o.
+  void attach_solve_options(solver& s, solve_options& o, int run)
+    {
+    s.metrics = o.metrics.is_open() ? &o.metrics : nullptr;
+    s.checkpoints = o.checkpoints.is_open() ? &o.checkpoints : nullptr;
+    s.checkpoint_interval = o.checkpoint_interval;
+    s.publisher = o.publisher.is_open() ? &o.publisher : nullptr;
+    s.run = run;
+    }
+
+  // Writes the last checkpoint and the trace.
+  void close_solve_options(solve_options& o)
+    {
+    o.checkpoints.close();
+    const std::string error = o.checkpoints.take_error();
+    if (!error.empty())
+      std::cerr << error << "\n";
+    write_trace(o.trace_filename);
+    }
+
+  template <class Level>
+  std::string level_text(const Level& lvl)
+    {
+    std::stringstream str;
+    write_level(str, lvl);
+    return str.str();
+    }
+
+  // Solves lvl, a level or a corpus_level, from a freshly seeded random generator, and appends its manifest if requested.
+  template <class Level>
+  bool solve_level(solver& s, const Level& lvl, solve_options& o, int run)
+    {
+    set_level(lvl);
+    seed_random(o.seed);
+    s.engine = o.engine;
+    s.beam.width = o.beam_width;
+    s.macro.hold = o.hold;
+    run_manifest m;
+    // the text of the level is only needed for the manifest
+    begin_manifest(m, o.manifest.is_open() ? level_text(lvl) : std::string(), s, o.seed, o.size, o.max_generations);
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    attach_solve_options(s, o, run);
+    s.best_scores = o.manifest.is_open() ? &m.best_scores : nullptr;
+    init_solver(s, o.size);
+    m.landed = solve(s, o.max_generations);
+    m.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    s.best_scores = nullptr;
+    if (s.checkpoints && s.engine == engine_genetic)
+      s.checkpoints->push(s);
+    if (o.manifest.is_open())
+      write_manifest(o.manifest, m);
+    return m.landed;
+    }
+
+  bool ends_with(const std::string& s, const std::string& suffix)
+    {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+  bool read_level_file(level& lvl, const std::string& filename)
+    {
+    std::ifstream t(filename);
+    if (!t.is_open())
+      {
+      std::cerr << "cannot open " << filename << "\n";
+      return false;
+      }
+    std::string str((std::istreambuf_iterator<char>(t)), std::istreambuf_iterator<char>());
+    std::string error;
+    if (!parse_level(lvl, str, error))
+      {
+      std::cerr << filename << ": " << error << "\n";
+      return false;
+      }
+    return true;
+    }
+
+  int convert(int argc, char** argv)
+    {
+    if (argc < 4)
+      {
+      print_usage();
+      return 1;
+      }
+    std::vector<std::string> files;
+    for (int i = 3; i < argc; ++i)
+      {
+      if (std::filesystem::is_directory(argv[i]))
+        {
+        for (const auto& entry : std::filesystem::directory_iterator(argv[i]))
+          if (entry.is_regular_file() && ends_with(entry.path().string(), ".txt"))
+            files.push_back(entry.path().string());
+        }
+      else
+        files.push_back(argv[i]);
+      }
+    std::sort(files.begin(), files.end());
+    corpus_writer w;
+    std::string error;
+    if (!w.open(argv[2], error))
+      {
+      std::cerr << error << "\n";
+      return 1;
+      }
+    level lvl;
+    for (const auto& f : files)
+      {
+      if (read_level_file(lvl, f))
+        w.add(lvl);
+      }
+    const uint32_t nr_of_levels = w.size();
+    if (!w.close(error))
+      {
+      std::cerr << error << "\n";
+      return 1;
+      }
+    std::cout << "Wrote " << nr_of_levels << " levels to " << argv[2] << "\n";
+    return 0;
+    }
+
+  template <class Level>
+  void solve_named_level(const std::string& name, const Level& lvl, solve_options& o, int run)
+    {
+    solver s;
+    if (solve_level(s, lvl, o, run))
+      std::cout << name << ": valid landing after " << s.generation << " generations\n";
+    else
+      std::cout << name << ": no valid landing within " << o.max_generations << " generations\n";
+#if defined(MARSLANDER_COUNTERS)
+    std::cout << "  " << s.total_counters << "\n";
+#endif
+    }
+
+  int solve(int argc, char** argv)
+    {
+    if (argc < 3)
+      {
+      print_usage();
+      return 1;
+      }
+    solve_options o;
+    if (!open_solve_options(o, argc, argv, 3))
+      return 1;
+    const std::string filename(argv[2]);
+    if (ends_with(filename, ".mlc"))
+      {
+      corpus c;
+      std::string error;
+      if (!c.open(filename.c_str(), error))
+        {
+        std::cerr << error << "\n";
+        return 1;
+        }
+      for (uint32_t i = 0; i < c.size(); ++i)
+        {
+        const std::string name = filename + "[" + std::to_string(i) + "]";
+        if (!validate_level(c[i], error))
+          std::cerr << name << ": " << error << "\n";
+        else
+          solve_named_level(name, c[i], o, (int)i);
+        }
+      }
+    else
+      {
+      level lvl;
+      if (!read_level_file(lvl, filename))
+        return 1;
+      solve_named_level(filename, lvl, o, 0);
+      }
+    close_solve_options(o);
+    return 0;
+    }
+
+  // Generates levels until one passes validate_level, so that no invalid level reaches a corpus or the solver.
+  bool generate_valid_level(level& lvl, RKISS& rng, const generator_settings& gs)
+    {
+    std::string error;
+    for (int attempt = 0; attempt < 100; ++attempt)
+      {
+      generate_level(lvl, rng, gs);
+      if (validate_level(lvl, error))
+        return true;
+      std::cerr << "skipping an invalid generated level: " << error << "\n";
+      }
+    return false;
+    }
+
+  int generate(int argc, char** argv)
+    {
+    if (argc < 3)
+      {
+      print_usage();
+      return 1;
+      }
+    const std::string target(argv[2]);
+    const int nr_of_levels = get_option(argc, argv, 3, "-n", 1000);
+    RKISS rng(get_option(argc, argv, 3, "-s", 73));
+    generator_settings gs = default_generator_settings();
+    gs.number_of_points = get_option(argc, argv, 3, "--points", gs.number_of_points);
+    gs.overhangs = get_option(argc, argv, 3, "--overhangs", gs.overhangs);
+    gs.caves = get_option(argc, argv, 3, "--caves", gs.caves);
+    gs.landing_zone_width = get_option(argc, argv, 3, "--lz-width", gs.landing_zone_width);
+    gs.maximum_initial_speed = get_option(argc, argv, 3, "--speed", gs.maximum_initial_speed);
+
+    level lvl;
+    if (target == "--solve")
+      {
+      solve_options o;
+      if (!open_solve_options(o, argc, argv, 3))
+        return 1;
+      int landed = 0;
+      hot_path_counters total_counters = hot_path_counters();
+      for (int i = 0; i < nr_of_levels; ++i)
+        {
+        if (!generate_valid_level(lvl, rng, gs))
+          {
+          close_solve_options(o);
+          return 1;
+          }
+        solver s;
+        const bool valid_landing = solve_level(s, lvl, o, i);
+        if (valid_landing)
+          ++landed;
+        std::cout << "level " << i << ": " << lvl.surface.size() << " points, " << (valid_landing ? "valid landing after " : "no valid landing within ") << s.generation << " generations\n";
+        add(total_counters, s.total_counters);
+        }
+      std::cout << landed << " of " << nr_of_levels << " levels solved\n";
+#if defined(MARSLANDER_COUNTERS)
+      std::cout << total_counters << "\n";
+#endif
+      close_solve_options(o);
+      return 0;
+      }
+    if (ends_with(target, ".mlc"))
+      {
+      corpus_writer w;
+      std::string error;
+      if (!w.open(target.c_str(), error))
+        {
+        std::cerr << error << "\n";
+        return 1;
+        }
+      for (int i = 0; i < nr_of_levels; ++i)
+        {
+        if (!generate_valid_level(lvl, rng, gs))
+          return 1;
+        w.add(lvl);
+        }
+      if (!w.close(error))
+        {
+        std::cerr << error << "\n";
+        return 1;
+        }
+      }
+    else
+      {
+      std::filesystem::create_directories(target);
+      for (int i = 0; i < nr_of_levels; ++i)
+        {
+        if (!generate_valid_level(lvl, rng, gs))
+          return 1;
+        std::ofstream f(target + "/level" + std::to_string(i) + ".txt");
+        write_level(f, lvl);
+        }
+      }
+    std::cout << "Wrote " << nr_of_levels << " levels to " << target << "\n";
+    return 0;
+    }
+
+  int replay_manifests(int argc, char** argv)
+    {
+    if (argc < 3)
+      {
+      print_usage();
+      return 1;
+      }
+    std::vector<run_manifest> manifests;
+    std::string error;
+    if (!read_manifests(manifests, argv[2], error))
+      {
+      std::cerr << error << "\n";
+      return 1;
+      }
+    const std::string build = build_configuration();
+    int failures = 0;
+    for (size_t i = 0; i < manifests.size(); ++i)
+      {
+      const run_manifest& m = manifests[i];
+      if (m.build != build)
+        std::cout << "run " << i << ": recorded with a different build configuration: " << m.build << "\n";
+      replay_result r;
+      if (!replay(r, m, error))
+        {
+        std::cout << "run " << i << ": " << error << "\n";
+        ++failures;
+        continue;
+        }
+      if (r.first_mismatch >= 0)
+        std::cout << "run " << i << ": best score of generation " << r.first_mismatch << " is " << r.actual_score << ", recorded " << r.expected_score << "\n";
+      else if (!r.identical)
+        std::cout << "run " << i << ": " << (r.landed ? "lands" : "does not land") << ", recorded the opposite\n";
+      else
+        std::cout << "run " << i << ": identical, " << m.best_scores.size() - 1 << " generations in " << r.milliseconds << " ms, recorded " << m.milliseconds << " ms\n";
+      if (!r.identical)
+        ++failures;
+      }
+    std::cout << manifests.size() - failures << " of " << manifests.size() << " runs reproduced\n";
+    return failures > 0 ? 2 : 0;
+    }
+
+  int resume_checkpoint(int argc, char** argv)
+    {
+    if (argc < 3)
+      {
+      print_usage();
+      return 1;
+      }
+    checkpoint c;
+    std::string error;
+    if (!read_checkpoint(c, argv[2], error))
+      {
+      std::cerr << error << "\n";
+      return 1;
+      }
+    solve_options o;
+    if (!open_solve_options(o, argc, argv, 3))
+      return 1;
+    solver s;
+    resume_solver(s, c);
+    attach_solve_options(s, o, 0);
+    const bool valid_landing = solve(s, o.max_generations);
+    if (s.checkpoints)
+      s.checkpoints->push(s);
+    if (valid_landing)
+      std::cout << argv[2] << ": valid landing after " << s.generation << " generations\n";
+    else
+      std::cout << argv[2] << ": no valid landing within " << o.max_generations << " generations\n";
+    close_solve_options(o);
+    return 0;
+    }
+
+  int monitor(int argc, char** argv)
+    {
+    if (argc < 3)
+      {
+      print_usage();
+      return 1;
+      }
+    const int number_of_publications = get_option(argc, argv, 3, "-n", 0);
+    const int interval_ms = std::max(1, get_option(argc, argv, 3, "--interval", 100));
+    trajectory_reader r;
+    std::string error;
+    if (!r.open(argv[2], error))
+      {
+      std::cerr << error << "\n";
+      return 1;
+      }
+    published_trajectory t;
+    uint64_t last_sequence = 0;
+    int publications = 0;
+    while (number_of_publications <= 0 || publications < number_of_publications)
+      {
+      const bool active = r.segment()->active.load(std::memory_order_acquire) != 0;
+      // the sequence changes before the trajectory does, so polling it alone is free of copies
+      if (r.segment()->sequence.load(std::memory_order_acquire) != last_sequence)
+        {
+        last_sequence = r.read(t);
+        ++publications;
+        std::cout << "run " << t.run << " generation " << t.generation << ": score " << t.score;
+        std::cout << ", ends at (" << t.last.p.x << ", " << t.last.p.y << ") with speed (" << t.last.v.x << ", " << t.last.v.y << ")";
+        std::cout << ", fuel " << t.last.F << ", angle " << t.last.R << ", thrust " << t.last.P;
+        std::cout << (t.valid_landing ? ", valid landing" : "") << std::endl;
+        }
+      else if (!active)
+        {
+        std::cout << argv[2] << " was closed\n";
+        break;
+        }
+      std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+      }
+    return 0;
+    }
+  }
+
+int main(int argc, char** argv)
+  {
+  if (argc < 2)
+    {
+    print_usage();
+    return 1;
+    }
+  if (strcmp(argv[1], "convert") == 0)
+    return convert(argc, argv);
+  if (strcmp(argv[1], "solve") == 0)
+    return solve(argc, argv);
+  if (strcmp(argv[1], "generate") == 0)
+    return generate(argc, argv);
+  if (strcmp(argv[1], "replay") == 0)
+    return replay_manifests(argc, argv);
+  if (strcmp(argv[1], "resume") == 0)
+    return resume_checkpoint(argc, argv);
+  if (strcmp(argv[1], "monitor") == 0)
+    return monitor(argc, argv);
+  print_usage();
+  return 1;
+  }